@@ -18,6 +18,7 @@
 // Our stuff
 #include "joystick/joystick.h"
 #include "logging/logging.h"
+#include "tasks/tasks.h"
 #include "usb/usb.h"
 
 joystick joystick1;
@@ -77,20 +78,22 @@ int main(void)
 
     // Queue up the startup task for right after the scheduler starts
     TaskHandle_t startup_task_handle;
-    xTaskCreate(startup_task,
-                "startup_task",
-                configMINIMAL_STACK_SIZE,
-                NULL,
-                1,
-                &startup_task_handle);
-
-
-    xTaskCreate(adc_debugger_task,
-                "adc_debugger",
-                configMINIMAL_STACK_SIZE,
-                NULL,
-                1,
-                &adc_debugger_task_handler);
+    xTaskCreateAffinitySet(startup_task,
+                           "startup_task",
+                           configMINIMAL_STACK_SIZE,
+                           NULL,
+                           STARTUP_TASK_PRIORITY,
+                           TASK_CORE_MASK(STARTUP_TASK_CORE),
+                           &startup_task_handle);
+
+
+    xTaskCreateAffinitySet(adc_debugger_task,
+                           "adc_debugger",
+                           configMINIMAL_STACK_SIZE,
+                           NULL,
+                           ADC_DEBUGGER_TASK_PRIORITY,
+                           TASK_CORE_MASK(ADC_DEBUGGER_TASK_CORE),
+                           &adc_debugger_task_handler);
 
     vTaskStartScheduler();
 
@@ -64,9 +64,8 @@ extern "C" {
   #error "Incorrect RHPort configuration"
 #endif
 
-#ifndef CFG_TUSB_OS
-#define CFG_TUSB_OS               OPT_OS_NONE
-#endif
+// CFG_TUSB_OS comes from TINYUSB_OPT_OS in CMakeLists.txt, same as the controller's, so this
+// polls the stack with tud_task_ext() instead of blocking in tud_task()
 
 // CFG_TUSB_DEBUG is defined by compiler in DEBUG build
 // #define CFG_TUSB_DEBUG           0
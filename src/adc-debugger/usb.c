@@ -10,6 +10,7 @@
 
 #include "joystick/joystick.h"
 #include "logging/logging.h"
+#include "tasks/tasks.h"
 #include "usb/usb.h"
 #include "usb/usb_descriptors.h"
 
@@ -21,6 +22,8 @@ uint32_t events_processed = 0;
 extern joystick joystick1;
 extern pot pot1;
 
+// The debugger still runs TinyUSB off a timer
+void usbDeviceTimerCallback(TimerHandle_t xTimer);
 
 
 enum {
@@ -47,6 +50,9 @@ void usb_init() {
 
 void usb_start() {
 
+    // TinyUSB runs from the timer task, so it goes where USB lives
+    vTaskCoreAffinitySet(xTimerGetTimerDaemonTaskHandle(), TASK_CORE_MASK(TIMER_TASK_CORE));
+
     TimerHandle_t usbDeviceTimer = xTimerCreate(
             "usbDeviceTimer",              // Timer name
             pdMS_TO_TICKS(1),            // Every millisecond
@@ -69,7 +75,9 @@ void usb_start() {
 
 
 void usbDeviceTimerCallback(TimerHandle_t xTimer) {
-    tud_task();
+
+    // Don't wait on the event queue, this is the timer task
+    tud_task_ext(0, false);
 }
 
 
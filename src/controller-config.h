@@ -10,16 +10,124 @@
 // Just because it's funny
 #define EVER ;;
 
-// Could be 16 if there's two MCP3208s
-#define MAX_NUMBER_OF_AXEN          8
+// Two MCP3208s, eight channels each
+#define MAX_NUMBER_OF_AXEN          16
 
 
-// If this is defined, suspend the reader when there's no USB connection
+// Set this to 1 to keep the readers suspended until a host mounts the device, and suspend
+// them again when it goes away
 #define SUSPEND_READER_WHEN_NO_USB  0
 
 // How many milliseconds should we treat each frame?
 #define POLLING_INTERVAL            2
 
+// How many bits each axis gets in the HID report: 8, 12, or 16. 8 is the old layout with a
+// byte per axis, for hosts that were set up for it. The old report only had 8 buttons as well,
+// so those hosts need MAX_NUMBER_OF_BUTTONS at 8 too. 12 and 16 take two bytes per axis.
+// tools/hid-latency sets this from its own build to match the controller's.
+#ifndef HID_AXIS_BITS
+#define HID_AXIS_BITS               16
+#endif
+
+// Line the sample clock up with the USB start of frame. The ADC frame gets started
+// USB_SOF_LEAD_US before the frame the host polls in, and the report is queued as soon as
+// it's filtered, so it's sitting there when the IN token shows up. The lead needs to cover
+// reading and filtering a frame, which "latency" over CDC shows as tick to report. Without
+// this the reports go out on their own every millisecond.
+#define USB_SOF_SYNC                1
+#define USB_SOF_LEAD_US             1500
+
+// Only send a report when an axis or a button changed, or when the host's SET_IDLE interval
+// runs out. HID_DEFAULT_IDLE_MS is what that is until the host says, and 0 (what the HID
+// spec suggests for joysticks) means never. GET_REPORT gets the current state either way.
+#define HID_REPORT_ON_CHANGE        1
+#define HID_DEFAULT_IDLE_MS         0
+
+// Tack a sequence number, the frame's timestamp, and some flags onto the end of the joystick
+// report, on the vendor page so games skip right over them. tools/hid-latency reads them back
+// to measure drops, jitter, and how old the frames are by the time the host has them. It
+// sets this from its own build, so it doesn't have to match what's here.
+#ifndef HID_EXTENDED_REPORT
+#define HID_EXTENDED_REPORT         0
+#endif
+
+// A second report, on the vendor page, with every frame since the last one in it. The ADC
+// runs at HID_HISTORY_SAMPLE_RATE_HZ instead of once a poll, and the host can put the motion
+// back together a lot finer than the polling interval.
+//
+// As many samples go in a report as fit in the 64 byte endpoint: 5 with 8 bit axes, 4 with
+// 12, and 3 with 16 (HID_HISTORY_AXIS_BITS). If HID_HISTORY_SAMPLE_RATE_HZ brings in more
+// than that between polls it won't build. The joystick report still
+// goes out when a button changes, or when the axes have moved and it's been
+// HID_HISTORY_JOYSTICK_MS since the last one, and every poll it doesn't take gets a history
+// report. The poll after a joystick report has two polls' worth waiting, so at the limit a
+// few frames get counted as lost every HID_HISTORY_JOYSTICK_MS.
+//
+// Eight axes have to be read in every frame, and that won't fit at the default SPI clock and
+// oversampling either. Turn ADC_DEFAULT_OVERSAMPLE down or ADC_SPI_BAUD_RATE up (2MHz is fine
+// with the MCP3208s on 5V), or it won't build.
+#define HID_HISTORY_REPORT          0
+#define HID_HISTORY_SAMPLE_RATE_HZ  2000
+#define HID_HISTORY_AXIS_BITS       12
+#define HID_HISTORY_JOYSTICK_MS     10
+
+
+/*
+ * ADC Config
+ */
+
+// Which engine reads the MCP3208s. The SPI peripheral driven by a chain of DMA control
+// blocks, or a PIO state machine that runs on its own.
+#define ADC_SCAN_BACKEND_SPI_DMA    0
+#define ADC_SCAN_BACKEND_PIO        1
+#define ADC_SCAN_BACKEND            ADC_SCAN_BACKEND_SPI_DMA
+
+// Set this if the second MCP3208 has its own SPI bus (see ADC1_SPI in adc.h). Then both
+// ADCs are read at the same time, and 16 axes take as long as 8. Otherwise they share one
+// bus and take turns.
+#define ADC_SEPARATE_BUSES          0
+
+// SPI clock for the MCP3208s
+#define ADC_SPI_BAUD_RATE           (750 * 1000)
+
+// PIO block for the ADC state machine (the lights are on pio1, the button scanner's on BUTTON_PIO)
+#define ADC_PIO                     pio0
+
+// How many frames a second to read. The sample clock runs at this rate, and so does the
+// PIO backend on its own.
+#if HID_HISTORY_REPORT
+#define ADC_FRAME_RATE_HZ           HID_HISTORY_SAMPLE_RATE_HZ
+#else
+#define ADC_FRAME_RATE_HZ           (1000 / POLLING_INTERVAL)
+#endif
+
+// Most the sample clock gets moved in one tick when it's being lined up with something
+#define SAMPLE_CLOCK_MAX_NUDGE_US   50
+
+// Buckets for the frame jitter histogram, centered on the nominal frame interval
+#define JITTER_HISTOGRAM_BUCKETS    128
+#define JITTER_HISTOGRAM_BUCKET_US  2
+
+// How many conversions each axis gets per frame, unless create_axis() is told otherwise.
+// They're read back to back and averaged into a 16 bit value before the filter, so every
+// 4x buys about one more bit.
+#define ADC_DEFAULT_OVERSAMPLE      4
+#define ADC_MAX_OVERSAMPLE          8
+
+// Most conversions there can be in one frame, across every axis. Every axis at
+// ADC_MAX_OVERSAMPLE has to fit, and it can't be more than 255.
+#define ADC_SCAN_MAX_SLOTS          (MAX_NUMBER_OF_AXEN * ADC_MAX_OVERSAMPLE)
+
+// How many completed frames the scan engine keeps in its ring buffer
+#define ADC_SCAN_RING_DEPTH         4
+
+// If a frame isn't done in this long, something's wrong with the DMA
+#define ADC_SCAN_TIMEOUT_MS         10
+
+// How many finished frames the controller state keeps around for anything that wants all of
+// them. Has to be a power of two.
+#define CONTROLLER_STATE_HISTORY_LENGTH 32
+
 
 /**
  * Analog Read Filter
@@ -32,10 +140,94 @@
  */
 #define ANALOG_READ_FILTER_SNAP_VALUE 0.2
 
+// Do the filter's math in fixed point instead of float. The M0+ doesn't have an FPU.
+#define ANALOG_FILTER_FIXED_POINT   1
+
+// The snap curve comes out of a table built at compile time. 2^BITS segments, and the build
+// fails if the table is ever more than MAX_ERROR (Q16 counts) off from the real curve.
+#define SNAP_CURVE_TABLE_BITS           8
+#define SNAP_CURVE_TABLE_INTERPOLATE    1
+#define SNAP_CURVE_TABLE_MAX_ERROR      2
+
+// Let each axis work out its own noise floor while it's sitting still, and set its activity
+// threshold from that instead of using the same one everywhere. The thresholds are in ADC counts.
+#define ANALOG_FILTER_NOISE_ADAPTATION          1
+#define ANALOG_FILTER_NOISE_WINDOW              256     // Samples per estimate
+#define ANALOG_FILTER_NOISE_SIGMAS              4       // Threshold is this many standard deviations
+#define ANALOG_FILTER_MIN_ACTIVITY_THRESHOLD    4
+#define ANALOG_FILTER_MAX_ACTIVITY_THRESHOLD    64
+#define ANALOG_FILTER_MIN_ERROR_EMA_GAIN        0.1f
+
+// Response curves get compiled into tables of 2^BITS entries. Axes with the same curve share
+// a table, and each one is 2^(BITS+1) bytes of RAM.
+#define RESPONSE_CURVE_TABLE_BITS   12
+#define RESPONSE_CURVE_MAX_TABLES   4
+#define RESPONSE_CURVE_MAX_POINTS   8
+
+// What an axis gets if the EEPROM doesn't have a curve for it. The deadzone is in 16 bit
+// counts each side of the middle, and only goes on axes that spring back to center.
+#define RESPONSE_CURVE_DEFAULT_CENTER_DEADZONE  0
+#define RESPONSE_CURVE_DEFAULT_EXPO             0
+
+// Calibration capture. The sticks need to be left alone for CALIBRATION_CENTER_MS at the start,
+// and an axis has to move at least CALIBRATION_MIN_SPAN (16 bit counts) to get a new range.
+#define CALIBRATION_SAMPLE_MS       10
+#define CALIBRATION_CENTER_MS       1000
+#define CALIBRATION_MIN_SPAN        8192
+
+// How many filter stages an axis can chain together
+#define FILTER_PIPELINE_MAX_STAGES  4
+
 
 #define DEBUG_ADC 0
 
 
+/*
+ * Task placement
+ */
+
+// Sampling and filtering go on core 1. The analog reader sets up the sample clock and the
+// ADC DMA, and the button reader sets up the button scanner, so their IRQs are on core 1 with
+// them. USB is on core 0: the startup task that brings up TinyUSB (so the USB IRQ lands there
+// too), the device task that runs it, and the HID task. The rest of it shares core 0 at the
+// bottom.
+//
+// None of this has been measured on a controller yet, it's just where things seemed to
+// belong. The "tasks" and "latency" CDC commands are there to check it, and
+// TASKS_ON_ONE_CORE puts everything on core 0 to compare against.
+#define TASKS_ON_ONE_CORE               0
+
+#define SAMPLING_CORE                   1
+#define USB_CORE                        0
+#define BACKGROUND_CORE                 0
+
+// Which core each task runs on, and its priority. The timer task is above all of these at
+// configMAX_PRIORITIES - 1. The button reader is over the analog reader so a press shouldn't
+// have to wait on a frame of filtering.
+#define ANALOG_READER_TASK_CORE         SAMPLING_CORE
+#define ANALOG_READER_TASK_PRIORITY     20
+#define BUTTON_READER_TASK_CORE         SAMPLING_CORE
+#define BUTTON_READER_TASK_PRIORITY     21
+#define STARTUP_TASK_CORE               USB_CORE
+#define STARTUP_TASK_PRIORITY           10
+#define USB_DEVICE_TASK_CORE            USB_CORE
+#define USB_DEVICE_TASK_PRIORITY        25
+#define HID_TASK_CORE                   USB_CORE
+#define HID_TASK_PRIORITY               24
+#define TIMER_TASK_CORE                 BACKGROUND_CORE
+#define LOG_READER_TASK_CORE            BACKGROUND_CORE
+#define LOG_READER_TASK_PRIORITY        2
+#define DISPLAY_TASK_CORE               BACKGROUND_CORE
+#define DISPLAY_TASK_PRIORITY           1
+#define STATUS_LIGHTS_TASK_CORE         BACKGROUND_CORE
+#define STATUS_LIGHTS_TASK_PRIORITY     1
+#define CALIBRATION_WRITER_TASK_CORE    BACKGROUND_CORE
+#define CALIBRATION_WRITER_TASK_PRIORITY 1
+
+// Most tasks the CPU stats can keep track of
+#define TASK_STATS_MAX_TASKS            16
+
+
 /*
  * Display Stuff
  */
@@ -60,15 +252,47 @@
 #define BUTTON_MUX2                 20
 #define BUTTON_MUX3                 21
 
-// Only 8 for now since there's just one mux
-typedef uint8_t button_t;                   // These two need to be
-#define MAX_NUMBER_OF_BUTTONS       8       // be the same size
+// 8, 16, or 32. One mux has 16 lines, so 32 needs a second one on the same select lines, with
+// its output on BUTTON_IN + 1.
+#define MAX_NUMBER_OF_BUTTONS       16
+
+// Big enough to hold all of them as a mask, which is also how they go in the HID report
+#if MAX_NUMBER_OF_BUTTONS == 8
+typedef uint8_t button_t;
+#elif MAX_NUMBER_OF_BUTTONS == 16
+typedef uint16_t button_t;
+#elif MAX_NUMBER_OF_BUTTONS == 32
+typedef uint32_t button_t;
+#else
+#error "MAX_NUMBER_OF_BUTTONS has to be 8, 16, or 32"
+#endif
 
 // Helper to make masks
 #define GPIO_MASK(pin) (1u << (pin))
 
 #define BUTTON_IN                   22
 
+// The mux gets walked by a PIO state machine on its own, this many times a second. The MUX
+// needs BUTTON_MUX_SETTLE_NS after the select lines change before its output is good.
+#define BUTTON_PIO                      pio0
+#define BUTTON_SCAN_RATE_HZ             20000
+
+// How often the button reader sweeps the debouncers, on top of whenever the scanner sees a
+// change. It's woken by the sample clock, so the ADC frame rate has to be a multiple of this.
+#define BUTTON_READ_RATE_HZ             (1000 / POLLING_INTERVAL)
+#define BUTTON_MUX_SETTLE_NS            200
+
+// How the buttons get debounced unless they're told otherwise. BUTTON_DEBOUNCE_LOCKOUT changes
+// on the first edge the scanner sees and then ignores the button for BUTTON_DEBOUNCE_LOCKOUT_US.
+// BUTTON_DEBOUNCE_INTEGRATOR waits for BUTTON_DEBOUNCE_SAMPLES sweeps in a row to agree, which
+// is a few ms at BUTTON_READ_RATE_HZ, but a glitch can't fake a press.
+#define BUTTON_DEBOUNCE_DEFAULT_MODE    BUTTON_DEBOUNCE_LOCKOUT
+#define BUTTON_DEBOUNCE_SAMPLES         3
+#define BUTTON_DEBOUNCE_LOCKOUT_US      (20 * 1000)
+
+// Press and release events waiting to be read. Has to be a power of two.
+#define BUTTON_EVENT_QUEUE_LENGTH       64
+
 /*
  * NeoPixel stuffs
  */
@@ -8,8 +8,10 @@
 
 #include "controller-config.h"
 
+#include "joystick/controller_state.h"
 #include "joystick/joystick.h"
 #include "logging/logging.h"
+#include "tasks/tasks.h"
 
 #include "display_wrapper.h"
 #include "display_task.h"
@@ -36,16 +38,20 @@ extern TaskHandle_t analog_reader_task_handler;
 
 extern volatile size_t xFreeHeapSpace;
 
+// There's only room for three digits an axis, so show them as 8 bits no matter how wide the report is
+#define DISPLAY_AXIS(a) (state.axes[(a).index] >> (HID_AXIS_BITS - 8))
+
 void display_start_task_running(volatile display_t *d) {
 
     info("starting display");
 
-    xTaskCreate(display_update_task,
-                "display_update_task",
-                1024,
-                (void*)d,         // Pass in a reference to our display
-                1,                      // Low priority
-                &display_update_task_handle);
+    xTaskCreateAffinitySet(display_update_task,
+                           "display_update_task",
+                           1024,
+                           (void*)d,         // Pass in a reference to our display
+                           DISPLAY_TASK_PRIORITY,
+                           TASK_CORE_MASK(DISPLAY_TASK_CORE),
+                           &display_update_task_handle);
 }
 
 
@@ -93,11 +99,14 @@ portTASK_FUNCTION(display_update_task, pvParameters) {
             device_mounted ? "Yes" : "No",
             usb_bus_active ? "Yes" : "No");
 
+    controller_state state;
+    controller_state_read(&state);
+
     sprintf(buffer[2], "L: %4d %4d %4d %4d",
-            joystick1.x.filtered_value, joystick1.y.filtered_value, joystick1.z.filtered_value, pot1.z.filtered_value);
+            DISPLAY_AXIS(joystick1.x), DISPLAY_AXIS(joystick1.y), DISPLAY_AXIS(joystick1.z), DISPLAY_AXIS(pot1.z));
 
     sprintf(buffer[3], "R: %4d %4d %4d %4d",
-                joystick2.x.filtered_value, joystick2.y.filtered_value, joystick2.z.filtered_value, pot2.z.filtered_value);
+                DISPLAY_AXIS(joystick2.x), DISPLAY_AXIS(joystick2.y), DISPLAY_AXIS(joystick2.z), DISPLAY_AXIS(pot2.z));
 
 
     display_draw_text_small(d, buffer[0], 0, 0);
@@ -103,6 +103,52 @@ void eeprom_read(i2c_inst_t *i2c, uint8_t eeprom_addr, uint16_t mem_addr, uint8_
 }
 
 
+/**
+ * Write data to the EEPROM
+ *
+ * Writes can't cross a page boundary, so this goes a page at a time and waits for each one
+ * to finish. The chip doesn't ACK its address while it's busy writing, so that's how we know.
+ *
+ * @return true if it all got written
+ */
+bool eeprom_write(i2c_inst_t *i2c, uint8_t eeprom_addr, uint16_t mem_addr, const uint8_t *data, size_t len) {
+
+    uint8_t buffer[2 + EEPROM_PAGE_SIZE];
+
+    while (len > 0) {
+        size_t room = EEPROM_PAGE_SIZE - (mem_addr % EEPROM_PAGE_SIZE);
+        size_t write_len = len > room ? room : len;
+
+        debug("writing %u bytes starting at address 0x%02X", write_len, mem_addr);
+
+        buffer[0] = (uint8_t)((mem_addr >> 8) & 0xFF);
+        buffer[1] = (uint8_t)(mem_addr & 0xFF);
+        memcpy(&buffer[2], data, write_len);
+
+        if (i2c_write_blocking(i2c, eeprom_addr, buffer, 2 + write_len, false) != (int)(2 + write_len)) {
+            error("EEPROM didn't take the write at 0x%02X", mem_addr);
+            return false;
+        }
+
+        // Poll until it's done with the page
+        absolute_time_t give_up = make_timeout_time_ms(EEPROM_WRITE_TIMEOUT_MS);
+        uint8_t dummy;
+        while (i2c_read_blocking(i2c, eeprom_addr, &dummy, 1, false) < 0) {
+            if (time_reached(give_up)) {
+                error("EEPROM write at 0x%02X never finished", mem_addr);
+                return false;
+            }
+        }
+
+        data += write_len;
+        mem_addr += write_len;
+        len -= write_len;
+    }
+
+    return true;
+}
+
+
 /**
  * Parse the EEPROM data
  *
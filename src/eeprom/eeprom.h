@@ -16,8 +16,18 @@
 #define MAGIC_WORD "HOP!"
 #define MAGIC_WORD_SIZE 4
 
+// The calibration lives in its own block after the config, so writing one can't hurt the other
+#define EEPROM_CALIBRATION_ADDRESS 0x0100
+
+// And the response curves after that, which the programmer writes like the config
+#define EEPROM_CURVES_ADDRESS 0x0200
+
+// How long a page write can take before we give up on it
+#define EEPROM_WRITE_TIMEOUT_MS 20
+
 void eeprom_setup_i2c();
 void eeprom_read(i2c_inst_t *i2c, uint8_t eeprom_addr, uint16_t mem_addr, uint8_t *data, size_t len);
+bool eeprom_write(i2c_inst_t *i2c, uint8_t eeprom_addr, uint16_t mem_addr, const uint8_t *data, size_t len);
 void read_eeprom_and_configure();
 int parse_eeprom_data(const uint8_t *data, size_t len);
 int extract_string(const uint8_t *data, size_t len, size_t *offset,
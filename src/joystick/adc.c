@@ -7,13 +7,6 @@
 
 #include "logging/logging.h"
 
-#define ADC0_CS_PIN             5
-#define ADC1_CS_PIN             6
-
-#define CHANNELS_PER_ADC        8
-#define NUMBER_OF_ADCS          2
-#define TOTAL_NUM_ADC_CHANNELS  CHANNELS_PER_ADC * NUMBER_OF_ADCS
-
 // Function to convert an integer to a binary string
 const char* toBinaryString(uint8_t value) {
     static char bStr[9];
@@ -29,11 +22,20 @@ void joystick_adc_init() {
 
     debug("bringing up the ADC");
 
-    spi_init(spi0, 1000 * 750);
-    spi_set_format(spi0, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
-    gpio_set_function(2, GPIO_FUNC_SPI);
-    gpio_set_function(3, GPIO_FUNC_SPI);
-    gpio_set_function(4, GPIO_FUNC_SPI);
+    spi_init(ADC_SPI, ADC_SPI_BAUD_RATE);
+    spi_set_format(ADC_SPI, 12, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(ADC_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(ADC_MOSI_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(ADC_MISO_PIN, GPIO_FUNC_SPI);
+
+#if ADC_SEPARATE_BUSES
+    // The second ADC gets a bus of its own so both can be read at once
+    spi_init(ADC1_SPI, ADC_SPI_BAUD_RATE);
+    spi_set_format(ADC1_SPI, 12, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(ADC1_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(ADC1_MOSI_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(ADC1_MISO_PIN, GPIO_FUNC_SPI);
+#endif
 
 
     // Chip Select (ADC0)
@@ -48,7 +50,7 @@ void joystick_adc_init() {
 
     vTaskDelay(pdMS_TO_TICKS(5));
 
-    info("SPI set up for spi0");
+    info("SPI set up for the ADCs on %u bus(es)", ADC_NUMBER_OF_BUSES);
 }
 
 
@@ -58,39 +60,57 @@ uint16_t joystick_read_adc(uint8_t analog_channel) {
     configASSERT(analog_channel < TOTAL_NUM_ADC_CHANNELS);
 
     uint8_t adc_channel = analog_channel % CHANNELS_PER_ADC;
-    uint8_t acd_cs = analog_channel <= CHANNELS_PER_ADC ? ADC0_CS_PIN : ADC1_CS_PIN;
+    uint8_t acd_cs = adc_cs_pin_for_channel(analog_channel);
 
     verbose("read channel %u -> channel %u, CS %u", analog_channel, adc_channel, acd_cs);
-    return adc_read(adc_channel, acd_cs);
+    return adc_read(adc_spi_for_bus(adc_bus_for_channel(analog_channel)), adc_channel, acd_cs);
+
+}
 
+/**
+ * Channels 0-7 are on the first ADC, 8-15 on the second
+ */
+uint8_t adc_cs_pin_for_channel(uint8_t analog_channel) {
+    return analog_channel < CHANNELS_PER_ADC ? ADC0_CS_PIN : ADC1_CS_PIN;
 }
 
-uint16_t adc_read(uint8_t adc_channel, uint8_t adc_num_cs_pin) {
+/**
+ * Which SPI bus a channel is on. Always 0 unless ADC_SEPARATE_BUSES is on.
+ */
+uint8_t adc_bus_for_channel(uint8_t analog_channel) {
+#if ADC_SEPARATE_BUSES
+    return analog_channel < CHANNELS_PER_ADC ? 0 : 1;
+#else
+    (void) analog_channel;
+    return 0;
+#endif
+}
+
+spi_inst_t* adc_spi_for_bus(uint8_t bus) {
+    return bus == 0 ? ADC_SPI : ADC1_SPI;
+}
 
-    // Command to read from a specific channel in single-ended mode
-    // Start bit, SGL/DIFF, and D2 bit of the channel
-    uint8_t cmd0 = 0b00000110 | ((adc_channel & 0b100) >> 2);
-    uint8_t cmd1 = (adc_channel & 0b011) << 6; // Remaining channel bits positioned
+uint16_t adc_read(spi_inst_t *spi, uint8_t adc_channel, uint8_t adc_num_cs_pin) {
 
-    uint8_t txBuffer[3] = {cmd0, cmd1, 0x00}; // The last byte doesn't matter, it's just to clock out the ADC data
-    uint8_t rxBuffer[3] = {0}; // To store the response
+    // Command to read from a specific channel in single-ended mode. The second word
+    // doesn't matter, it's just to clock out the ADC data
+    uint16_t txBuffer[2] = {MCP3208_COMMAND(adc_channel), 0x0000};
+    uint16_t rxBuffer[2] = {0}; // To store the response
 
     gpio_put(adc_num_cs_pin, 0); // Activate CS to start the transaction
-    spi_write_read_blocking(spi0, txBuffer, rxBuffer, 3); // Send the command and read the response
+    spi_write16_read16_blocking(spi, txBuffer, rxBuffer, 2); // Send the command and read the response
     gpio_put(adc_num_cs_pin, 1); // Deactivate CS to end the transaction
 
-    // Now, interpret the response:
-    // Skip the first 6 bits of rxBuffer[1], then take the next 10 bits as the ADC value
-    uint16_t adcResult = ((rxBuffer[1] & 0x0F) << 8) | rxBuffer[2];
+    // The second frame is the 12 bit result
+    uint16_t adcResult = rxBuffer[1] & 0x0FFF;
 
     // Debug print
 #if DEBUG_ADC == 1
     if (adc_channel == 2)
-        debug("ADC Channel: %d, Raw SPI Data: %s %s %s, ADC Result: %u",
+        debug("ADC Channel: %d, Raw SPI Data: %s %s, ADC Result: %u",
                adc_channel,
-               toBinaryString(rxBuffer[0]),
-               toBinaryString(rxBuffer[1]),
-               toBinaryString(rxBuffer[2]),
+               toBinaryString(rxBuffer[1] >> 8),
+               toBinaryString(rxBuffer[1] & 0xFF),
                adcResult);
 #endif
 
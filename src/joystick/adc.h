@@ -1,6 +1,9 @@
 
 #pragma once
 
+#include "hardware/spi.h"
+
+#include "controller-config.h"
 #include "logging/logging.h"
 
 #ifdef __cplusplus
@@ -8,11 +11,53 @@ extern "C"
 {
 #endif
 
+#define ADC_SPI                 spi0
+
+#define ADC_SCK_PIN             2
+#define ADC_MOSI_PIN            3
+#define ADC_MISO_PIN            4
+
+#define ADC0_CS_PIN             5
+#define ADC1_CS_PIN             6
+
+// Where the second MCP3208 lives when ADC_SEPARATE_BUSES is on. CS stays on ADC1_CS_PIN.
+#define ADC1_SPI                spi1
+#define ADC1_SCK_PIN            10
+#define ADC1_MOSI_PIN           11
+#define ADC1_MISO_PIN           12
+
+#if ADC_SEPARATE_BUSES
+#define ADC_NUMBER_OF_BUSES     2
+#else
+#define ADC_NUMBER_OF_BUSES     1
+#endif
+
+#define CHANNELS_PER_ADC        8
+#define NUMBER_OF_ADCS          2
+#define TOTAL_NUM_ADC_CHANNELS  (CHANNELS_PER_ADC * NUMBER_OF_ADCS)
+
+// The MCP3208 is a 12 bit ADC
+#define ADC_RESOLUTION_BITS     12
+#define ADC_MAX_VALUE           ((1 << ADC_RESOLUTION_BITS) - 1)
+
+// The MCP3208 wants CS to be high for at least 500ns between conversions
+#define ADC_CS_HIGH_TIME_NS     500
+
+/*
+ * The MCP3208 is clocked with two 12-bit SPI frames per conversion. The start bit lands on the
+ * 6th clock, followed by SGL/DIFF and the three channel bits. The second frame clocks out
+ * exactly the 12 bit result, so it can be used as-is without any shifting or masking.
+ */
+#define MCP3208_COMMAND(channel)    ((uint16_t)(0x60 | (((channel) & 0x07) << 2)))
+
 void joystick_adc_init();
 uint16_t joystick_read_adc(uint8_t adc_channel);
-uint16_t adc_read(uint8_t adc_channel, uint8_t adc_num_cs_pin);
+uint16_t adc_read(spi_inst_t *spi, uint8_t adc_channel, uint8_t adc_num_cs_pin);
+uint8_t adc_cs_pin_for_channel(uint8_t analog_channel);
+uint8_t adc_bus_for_channel(uint8_t analog_channel);
+spi_inst_t* adc_spi_for_bus(uint8_t bus);
 
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,198 @@
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "controller-config.h"
+
+#include "joystick/adc.h"
+#include "joystick/adc_scan.h"
+#include "joystick/adc_scan_backend.h"
+
+#include "logging/logging.h"
+
+
+// What we're scanning
+uint8_t adc_scan_number_of_slots = 0;
+uint8_t adc_scan_slot_channel[ADC_SCAN_MAX_SLOTS];
+uint8_t adc_scan_order[ADC_SCAN_MAX_SLOTS];
+
+// The reader task that wants to know when a frame is done
+static TaskHandle_t reader_task_handle;
+
+static adc_scan_frame ring[ADC_SCAN_RING_DEPTH];
+static volatile uint8_t ring_head = 0;
+
+static volatile bool busy = false;
+static volatile uint32_t frames_completed = 0;
+static volatile uint32_t frames_overrun = 0;
+
+// Time between frames
+static jitter_histogram frame_jitter;
+
+
+void adc_scan_init(TaskHandle_t reader_task) {
+
+    debug("bringing up the ADC scan engine");
+
+    reader_task_handle = reader_task;
+    adc_scan_number_of_slots = 0;
+    memset(ring, '\0', sizeof(ring));
+    jitter_histogram_init(&frame_jitter, 1000000 / ADC_FRAME_RATE_HZ);
+
+    adc_scan_backend_init();
+}
+
+/**
+ * Add a channel to the frame
+ *
+ * @param analog_channel the channel (0-15) to read
+ * @return the slot in adc_scan_frame.values that'll have the result
+ */
+uint8_t adc_scan_add_channel(uint8_t analog_channel) {
+
+    configASSERT(analog_channel < TOTAL_NUM_ADC_CHANNELS);
+
+    // fatal() only queues up a message, and everything past here would write off the end of
+    // the slot tables, so this has to stop right here
+    if(adc_scan_number_of_slots >= ADC_SCAN_MAX_SLOTS) {
+        panic("more than %d slots in the ADC scan", ADC_SCAN_MAX_SLOTS);
+    }
+
+    uint8_t slot = adc_scan_number_of_slots++;
+    adc_scan_slot_channel[slot] = analog_channel;
+
+    verbose("ADC scan slot %u is channel %u", slot, analog_channel);
+    return slot;
+}
+
+/**
+ * Add a run of back to back conversions of the same channel to the frame
+ *
+ * @param analog_channel the channel (0-15) to read
+ * @param conversions how many times to read it
+ * @return the first slot of the run. The rest follow right after it.
+ */
+uint8_t adc_scan_add_burst(uint8_t analog_channel, uint8_t conversions) {
+
+    configASSERT(conversions > 0);
+
+    uint8_t first = adc_scan_add_channel(analog_channel);
+    for(uint8_t i = 1; i < conversions; i++) {
+        adc_scan_add_channel(analog_channel);
+    }
+
+    return first;
+}
+
+/**
+ * Work out the order to do the conversions in, then hand it all to the backend. A free
+ * running backend starts reading right away.
+ *
+ * The conversions alternate between the two ADCs wherever possible. One chip can do its
+ * conversion while the other one has CS high between conversions, so there's no dead time
+ * on the bus, and with separate buses each one gets half of the work. Bursts on the same
+ * chip stay in order.
+ */
+void adc_scan_build() {
+
+    uint8_t next[NUMBER_OF_ADCS] = {0};
+    uint8_t chip = 0;
+
+    for(uint8_t i = 0; i < adc_scan_number_of_slots; i++) {
+
+        // Find the next slot on this chip, or take one from the other if it's run out
+        for(uint8_t tries = 0; tries < NUMBER_OF_ADCS; tries++) {
+
+            while(next[chip] < adc_scan_number_of_slots &&
+                  adc_scan_slot_channel[next[chip]] / CHANNELS_PER_ADC != chip) {
+                next[chip]++;
+            }
+
+            if(next[chip] < adc_scan_number_of_slots) {
+                break;
+            }
+            chip = (chip + 1) % NUMBER_OF_ADCS;
+        }
+
+        adc_scan_order[i] = next[chip]++;
+        chip = (chip + 1) % NUMBER_OF_ADCS;
+    }
+
+    adc_scan_backend_build();
+}
+
+/**
+ * Kick off a frame. Returns false if the last one is still running.
+ *
+ * This is called from the sample clock's IRQ, so no logging.
+ */
+bool adc_scan_start_frame() {
+
+#if ADC_SCAN_FREE_RUNNING
+    // Frames just show up on their own
+    return true;
+#else
+    if(busy) {
+        frames_overrun++;
+        return false;
+    }
+
+    busy = true;
+    adc_scan_backend_start_frame();
+    return true;
+#endif
+}
+
+bool adc_scan_is_busy() {
+    return busy;
+}
+
+const adc_scan_frame* adc_scan_latest_frame() {
+    return &ring[ring_head];
+}
+
+uint32_t adc_scan_frames_completed() {
+    return frames_completed;
+}
+
+uint32_t adc_scan_frames_overrun() {
+    return frames_overrun;
+}
+
+const jitter_histogram* adc_scan_frame_jitter() {
+    return &frame_jitter;
+}
+
+void adc_scan_reset_frame_jitter() {
+    jitter_histogram_init(&frame_jitter, frame_jitter.nominal_us);
+}
+
+
+/**
+ * The ring slot that the frame in flight will end up in
+ */
+adc_scan_frame* adc_scan_next_frame() {
+    return &ring[(ring_head + 1) % ADC_SCAN_RING_DEPTH];
+}
+
+/**
+ * Called by the backend from its IRQ once adc_scan_next_frame() has been filled in
+ */
+void adc_scan_frame_done_from_isr() {
+
+    uint64_t now = time_us_64();
+
+    adc_scan_frame *f = adc_scan_next_frame();
+    f->frame_number = ++frames_completed;
+    f->timestamp_us = now;
+
+    jitter_histogram_record(&frame_jitter, now);
+
+    ring_head = (ring_head + 1) % ADC_SCAN_RING_DEPTH;
+    busy = false;
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(reader_task_handle, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
@@ -0,0 +1,73 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "controller-config.h"
+
+#include "util/jitter_histogram.h"
+
+/**
+ * Scan engine for the MCP3208s
+ *
+ * Every channel that needs to be read is registered up front, and the backend reads all of
+ * them as one frame without the CPU being involved. When a frame is done it lands in a ring
+ * buffer, stamped with time_us_64(), and the reader task gets a notification. The time
+ * between frames goes into a jitter histogram.
+ *
+ * There's two backends, picked with ADC_SCAN_BACKEND:
+ *
+ *   - ADC_SCAN_BACKEND_SPI_DMA uses the SPI peripheral, driven by a chain of DMA control
+ *     blocks. Each frame is started with adc_scan_start_frame(), which the sample clock does.
+ *
+ *   - ADC_SCAN_BACKEND_PIO uses a PIO state machine that runs on its own at ADC_FRAME_RATE_HZ.
+ *     adc_scan_start_frame() doesn't do anything.
+ */
+
+#define ADC_SCAN_FREE_RUNNING   (ADC_SCAN_BACKEND == ADC_SCAN_BACKEND_PIO)
+
+// Roughly how long one conversion takes: two 12 bit SPI frames, plus about a microsecond
+// with CS high
+#define ADC_SCAN_CONVERSION_US  (((24 * 1000000) / ADC_SPI_BAUD_RATE) + 1)
+
+#if ADC_SCAN_MAX_SLOTS > 255
+#error "Slots are counted with a uint8_t, ADC_SCAN_MAX_SLOTS can't be more than 255"
+#endif
+
+#if ADC_SCAN_MAX_SLOTS < MAX_NUMBER_OF_AXEN * ADC_MAX_OVERSAMPLE
+#error "ADC_SCAN_MAX_SLOTS needs room for every axis at ADC_MAX_OVERSAMPLE"
+#endif
+
+typedef struct {
+    uint32_t frame_number;
+    uint64_t timestamp_us;
+    uint16_t values[ADC_SCAN_MAX_SLOTS];
+} adc_scan_frame;
+
+void adc_scan_init(TaskHandle_t reader_task);
+uint8_t adc_scan_add_channel(uint8_t analog_channel);
+uint8_t adc_scan_add_burst(uint8_t analog_channel, uint8_t conversions);
+void adc_scan_build();
+
+bool adc_scan_start_frame();
+bool adc_scan_is_busy();
+
+const adc_scan_frame* adc_scan_latest_frame();
+uint32_t adc_scan_frames_completed();
+uint32_t adc_scan_frames_overrun();
+
+const jitter_histogram* adc_scan_frame_jitter();
+void adc_scan_reset_frame_jitter();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "joystick/adc_scan.h"
+
+/*
+ * The bits of the scan engine that are shared with the backends. Nothing outside of the
+ * scan engine should need this.
+ */
+
+extern uint8_t adc_scan_number_of_slots;
+extern uint8_t adc_scan_slot_channel[ADC_SCAN_MAX_SLOTS];
+
+// The order to do the conversions in, as slot numbers. Alternates between the two ADCs.
+extern uint8_t adc_scan_order[ADC_SCAN_MAX_SLOTS];
+
+adc_scan_frame* adc_scan_next_frame();
+void adc_scan_frame_done_from_isr();
+
+// Implemented by whichever backend ADC_SCAN_BACKEND picks
+void adc_scan_backend_init();
+void adc_scan_backend_build();
+void adc_scan_backend_start_frame();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,181 @@
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+
+#include "controller-config.h"
+
+#include "joystick/adc.h"
+#include "joystick/adc_scan.h"
+#include "joystick/adc_scan_backend.h"
+
+#include "logging/logging.h"
+
+#if ADC_SCAN_BACKEND == ADC_SCAN_BACKEND_PIO
+
+#include "mcp3208.pio.h"
+
+/*
+ * PIO backend for the scan engine
+ *
+ * The state machine does the whole conversion on its own, including the chip selects. One
+ * DMA channel feeds it the channel list over and over (with a second channel rewinding it
+ * at the end of each pass), and another drains the results. The idle time after the last
+ * conversion in the list pads each pass out to exactly one frame at ADC_FRAME_RATE_HZ, so
+ * the sample timing comes from the PIO clock and nothing else.
+ */
+
+#if ADC_SEPARATE_BUSES
+#error "The PIO backend only knows how to read both ADCs from one bus"
+#endif
+
+#if (ADC_MISO_PIN != ADC_MOSI_PIN + 1) || (ADC0_CS_PIN != ADC_MISO_PIN + 1) || (ADC1_CS_PIN != ADC0_CS_PIN + 1)
+#error "The PIO backend needs MOSI, MISO, CS0 and CS1 on consecutive pins"
+#endif
+
+static uint state_machine;
+
+// DMA channels
+static int tx_channel;
+static int rewind_channel;
+static int rx_channel;
+
+// The channel list in scan order, as command words for the state machine
+static uint32_t commands[ADC_SCAN_MAX_SLOTS];
+static const uint32_t *commands_address = commands;
+
+// The RX FIFO is 32 bits wide, so the results land here first. There's two of these so the
+// next frame can start while the last one gets copied out.
+static uint32_t landing[2][ADC_SCAN_MAX_SLOTS];
+static volatile uint8_t landing_index = 0;
+
+
+static void __isr adc_scan_pio_dma_irq_handler();
+
+
+void adc_scan_backend_init() {
+
+    memset(landing, '\0', sizeof(landing));
+
+    uint offset = pio_add_program(ADC_PIO, &mcp3208_program);
+    state_machine = pio_claim_unused_sm(ADC_PIO, true);
+
+    // Takes the pins away from the SPI peripheral. The state machine stalls until it gets a command.
+    mcp3208_program_init(ADC_PIO, state_machine, offset, ADC_SCK_PIN, ADC_MOSI_PIN, ADC_MISO_PIN,
+                         ADC0_CS_PIN, ADC_SPI_BAUD_RATE);
+
+    tx_channel = dma_claim_unused_channel(true);
+    rewind_channel = dma_claim_unused_channel(true);
+    rx_channel = dma_claim_unused_channel(true);
+
+    info("ADC scan engine using PIO state machine %u and DMA channels %d (tx), %d (rewind), %d (rx)",
+         state_machine, tx_channel, rewind_channel, rx_channel);
+}
+
+void adc_scan_backend_build() {
+
+    uint32_t pio_hz = ADC_SPI_BAUD_RATE * mcp3208_CYCLES_PER_CLOCK;
+
+    // Shortest idle that still keeps CS high long enough
+    uint32_t min_idle = ((pio_hz / 1000) * ADC_CS_HIGH_TIME_NS / 1000000) + 1;
+    min_idle = min_idle > mcp3208_CYCLES_CS_HIGH ? min_idle - mcp3208_CYCLES_CS_HIGH : 0;
+
+    uint32_t frame_cycles = pio_hz / ADC_FRAME_RATE_HZ;
+    uint32_t used_cycles = 0;
+
+    for(uint8_t i = 0; i < adc_scan_number_of_slots; i++) {
+
+        uint8_t channel = adc_scan_slot_channel[adc_scan_order[i]];
+        uint8_t cs_pin = adc_cs_pin_for_channel(channel);
+        uint8_t select = cs_pin == ADC0_CS_PIN ? MCP3208_PIO_SELECT_CS0 : MCP3208_PIO_SELECT_CS1;
+        uint32_t idle = 0;
+
+        // Only wait out the CS high time if the next conversion is on the same chip
+        if(i + 1 < adc_scan_number_of_slots &&
+           adc_cs_pin_for_channel(adc_scan_slot_channel[adc_scan_order[i + 1]]) == cs_pin) {
+            idle = min_idle;
+        }
+
+        used_cycles += mcp3208_CYCLES_PER_CONVERSION + idle;
+
+        // The last conversion soaks up whatever's left of the frame
+        if(i + 1 == adc_scan_number_of_slots) {
+            if(used_cycles + min_idle <= frame_cycles) {
+                idle += frame_cycles - used_cycles;
+            } else {
+                idle = min_idle;
+                warning("%u conversions don't fit in a frame at %uHz, running flat out",
+                        adc_scan_number_of_slots, ADC_FRAME_RATE_HZ);
+            }
+        }
+
+        commands[i] = mcp3208_pio_command(select, channel % CHANNELS_PER_ADC, idle);
+    }
+
+    // RX: one frame's worth of results, then the IRQ moves it to the other landing buffer
+    dma_channel_config c = dma_channel_get_default_config(rx_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(ADC_PIO, state_machine, false));
+    dma_channel_configure(rx_channel, &c, landing[0], &ADC_PIO->rxf[state_machine],
+                          adc_scan_number_of_slots, true);
+
+    dma_channel_set_irq0_enabled(rx_channel, true);
+    irq_add_shared_handler(DMA_IRQ_0, adc_scan_pio_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_priority(DMA_IRQ_0, PICO_LOWEST_IRQ_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    // TX: the whole channel list, then hand off to the rewind channel
+    c = dma_channel_get_default_config(tx_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(ADC_PIO, state_machine, true));
+    channel_config_set_chain_to(&c, rewind_channel);
+    dma_channel_configure(tx_channel, &c, &ADC_PIO->txf[state_machine], commands,
+                          adc_scan_number_of_slots, false);
+
+    // Rewind: point TX back at the top of the list, which also restarts it
+    c = dma_channel_get_default_config(rewind_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(rewind_channel, &c, &dma_hw->ch[tx_channel].al3_read_addr_trig, &commands_address,
+                          1, true);
+
+    info("ADC scan built: %u slots on the PIO at %uHz, %lu of %lu cycles per frame",
+         adc_scan_number_of_slots, ADC_FRAME_RATE_HZ, used_cycles, frame_cycles);
+}
+
+void adc_scan_backend_start_frame() {
+    // Nothing to do, the state machine paces itself
+}
+
+
+static void __isr adc_scan_pio_dma_irq_handler() {
+
+    if(!dma_channel_get_irq0_status(rx_channel)) {
+        return;
+    }
+    dma_channel_acknowledge_irq0(rx_channel);
+
+    // Get the next frame going before doing anything else
+    uint8_t done = landing_index;
+    landing_index ^= 1;
+    dma_channel_set_write_addr(rx_channel, landing[landing_index], true);
+
+    // The results come in the order they were read, put them back in slot order
+    adc_scan_frame *f = adc_scan_next_frame();
+    for(uint8_t i = 0; i < adc_scan_number_of_slots; i++) {
+        f->values[adc_scan_order[i]] = (uint16_t)(landing[done][i] & 0x0FFF);
+    }
+
+    adc_scan_frame_done_from_isr();
+}
+
+#endif
@@ -0,0 +1,266 @@
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/spi.h"
+#include "hardware/structs/iobank0.h"
+
+#include "controller-config.h"
+
+#include "joystick/adc.h"
+#include "joystick/adc_scan.h"
+#include "joystick/adc_scan_backend.h"
+
+#include "logging/logging.h"
+
+#if ADC_SCAN_BACKEND == ADC_SCAN_BACKEND_SPI_DMA
+
+/*
+ * SPI backend for the scan engine
+ *
+ * All of the conversions for a frame are described up front as a list of DMA control blocks.
+ * One DMA channel walks that list and reprograms a worker channel for each step: drop CS,
+ * kick the TX channel with the command for this channel, pull the result out of the SPI RX
+ * FIFO, and raise CS again. The CPU only gets involved once the whole frame is done.
+ *
+ * With ADC_SEPARATE_BUSES each ADC has its own SPI bus and its own set of channels, and
+ * both lists run at the same time. The frame is done when both of them are.
+ */
+
+// CS assert, TX kick, RX, CS release, and a delay for every slot, plus a null block for each bus
+#define ADC_SCAN_BLOCKS_PER_SLOT    5
+#define ADC_SCAN_MAX_BLOCKS         ((ADC_SCAN_MAX_SLOTS * ADC_SCAN_BLOCKS_PER_SLOT) + ADC_NUMBER_OF_BUSES)
+
+/**
+ * One step of the scan. The layout matches the alias 3 registers of a DMA channel, so the
+ * control channel can copy a block straight into the worker channel. Writing the read
+ * address is the trigger, so a block with a NULL read address ends the chain.
+ */
+typedef struct {
+    uint32_t ctrl;
+    volatile void *write_addr;
+    uint32_t transfer_count;
+    const volatile void *read_addr;
+} adc_scan_control_block;
+
+/**
+ * The DMA channels that drive one SPI bus
+ */
+typedef struct {
+    spi_inst_t *spi;
+    int control_channel;
+    int worker_channel;
+    int tx_channel;
+    adc_scan_control_block *first_block;
+} adc_scan_bus;
+
+
+static adc_scan_bus buses[ADC_NUMBER_OF_BUSES];
+
+// Which buses are still working on the frame
+static volatile uint8_t buses_pending = 0;
+
+// The list of steps that make up a frame, one run per bus
+static adc_scan_control_block control_blocks[ADC_SCAN_MAX_BLOCKS];
+
+// The command words for each slot, and where to find them
+static uint16_t commands[ADC_SCAN_MAX_SLOTS][2];
+static const uint16_t *command_addresses[ADC_SCAN_MAX_SLOTS];
+
+// Values to write into the GPIO control register of each CS pin
+static uint32_t cs_assert_value;
+static uint32_t cs_release_value;
+
+// Scratch word for the CS high delay
+static uint32_t delay_scratch;
+static uint32_t delay_transfers;
+
+// Where the DMA drops the results before they're copied into the ring
+static uint16_t landing[ADC_SCAN_MAX_SLOTS];
+
+
+static void __isr adc_scan_spi_dma_irq_handler();
+
+
+/**
+ * Value for a GPIO's control register that keeps it on the SIO, but forces the output
+ */
+static uint32_t cs_ctrl_value(uint outover) {
+    return (GPIO_FUNC_SIO << IO_BANK0_GPIO0_CTRL_FUNCSEL_LSB) | (outover << IO_BANK0_GPIO0_CTRL_OUTOVER_LSB);
+}
+
+static void adc_scan_bus_init(adc_scan_bus *bus, spi_inst_t *spi) {
+
+    bus->spi = spi;
+    bus->control_channel = dma_claim_unused_channel(true);
+    bus->worker_channel = dma_claim_unused_channel(true);
+    bus->tx_channel = dma_claim_unused_channel(true);
+    bus->first_block = control_blocks;
+
+    // The TX channel sends the two command words for a conversion each time it's triggered
+    dma_channel_config c = dma_channel_get_default_config(bus->tx_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, true));
+    dma_channel_configure(bus->tx_channel, &c, &spi_get_hw(spi)->dr, commands[0], 2, false);
+
+    // The control channel copies one block at a time into the worker's alias 3 registers
+    c = dma_channel_get_default_config(bus->control_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, 4);   // 1 << 4 = 16 bytes, one control block
+    dma_channel_configure(bus->control_channel, &c, &dma_hw->ch[bus->worker_channel].al3_ctrl,
+                          control_blocks, 4, false);
+
+    // The worker only raises an IRQ when it gets the null block at the end of the frame
+    dma_channel_set_irq0_enabled(bus->worker_channel, true);
+
+    info("ADC scan bus %d using DMA channels %d (control), %d (worker), %d (tx)",
+         spi_get_index(spi), bus->control_channel, bus->worker_channel, bus->tx_channel);
+}
+
+void adc_scan_backend_init() {
+
+    memset(landing, '\0', sizeof(landing));
+
+    // Releasing CS hands the pin back to the SIO, which joystick_adc_init() left high
+    cs_assert_value = cs_ctrl_value(GPIO_OVERRIDE_LOW);
+    cs_release_value = cs_ctrl_value(GPIO_OVERRIDE_NORMAL);
+
+    // Each DMA transfer takes at least a clock cycle, so this is the least we need
+    delay_transfers = ((clock_get_hz(clk_sys) / 1000000) * ADC_CS_HIGH_TIME_NS / 1000) + 1;
+
+    for(uint8_t i = 0; i < ADC_NUMBER_OF_BUSES; i++) {
+        adc_scan_bus_init(&buses[i], adc_spi_for_bus(i));
+    }
+
+    irq_add_shared_handler(DMA_IRQ_0, adc_scan_spi_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_priority(DMA_IRQ_0, PICO_LOWEST_IRQ_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+/**
+ * Turn the slots into the list of control blocks for a frame
+ */
+void adc_scan_backend_build() {
+
+    uint16_t b = 0;
+    uint32_t longest_bus_us = 0;
+
+    for(uint8_t bus_number = 0; bus_number < ADC_NUMBER_OF_BUSES; bus_number++) {
+
+        adc_scan_bus *bus = &buses[bus_number];
+        bus->first_block = &control_blocks[b];
+
+        // Every block but the last one goes back to the control channel to fetch the next one
+        dma_channel_config word = dma_channel_get_default_config(bus->worker_channel);
+        channel_config_set_transfer_data_size(&word, DMA_SIZE_32);
+        channel_config_set_read_increment(&word, false);
+        channel_config_set_write_increment(&word, false);
+        channel_config_set_chain_to(&word, bus->control_channel);
+        channel_config_set_irq_quiet(&word, true);
+
+        dma_channel_config rx = dma_channel_get_default_config(bus->worker_channel);
+        channel_config_set_transfer_data_size(&rx, DMA_SIZE_16);
+        channel_config_set_read_increment(&rx, false);
+        channel_config_set_write_increment(&rx, false);      // The result is the second word, let it land on top of the first
+        channel_config_set_dreq(&rx, spi_get_dreq(bus->spi, false));
+        channel_config_set_chain_to(&rx, bus->control_channel);
+        channel_config_set_irq_quiet(&rx, true);
+
+        uint32_t word_ctrl = channel_config_get_ctrl_value(&word);
+        uint32_t rx_ctrl = channel_config_get_ctrl_value(&rx);
+
+        volatile void *tx_trigger = &dma_hw->ch[bus->tx_channel].al3_read_addr_trig;
+        const volatile void *spi_dr = &spi_get_hw(bus->spi)->dr;
+
+        uint8_t conversions = 0;
+        uint8_t last_cs_pin = 0xFF;
+
+        for(uint8_t i = 0; i < adc_scan_number_of_slots; i++) {
+
+            uint8_t slot = adc_scan_order[i];
+            uint8_t channel = adc_scan_slot_channel[slot];
+
+            if(adc_bus_for_channel(channel) != bus_number) {
+                continue;
+            }
+
+            uint8_t cs_pin = adc_cs_pin_for_channel(channel);
+            volatile void *cs_ctrl = &io_bank0_hw->io[cs_pin].ctrl;
+
+            // Back to back on the same chip needs a gap with CS high. Switching chips doesn't.
+            if(cs_pin == last_cs_pin) {
+                control_blocks[b++] = (adc_scan_control_block){word_ctrl, &delay_scratch, delay_transfers, &delay_scratch};
+            }
+            last_cs_pin = cs_pin;
+
+            commands[slot][0] = MCP3208_COMMAND(channel % CHANNELS_PER_ADC);
+            commands[slot][1] = 0x0000;
+            command_addresses[slot] = commands[slot];
+
+            control_blocks[b++] = (adc_scan_control_block){word_ctrl, cs_ctrl, 1, &cs_assert_value};
+            control_blocks[b++] = (adc_scan_control_block){word_ctrl, tx_trigger, 1, &command_addresses[slot]};
+            control_blocks[b++] = (adc_scan_control_block){rx_ctrl, &landing[slot], 2, spi_dr};
+            control_blocks[b++] = (adc_scan_control_block){word_ctrl, cs_ctrl, 1, &cs_release_value};
+
+            conversions++;
+        }
+
+        // The null trigger ends this bus's part of the frame and fires the IRQ
+        control_blocks[b++] = (adc_scan_control_block){word_ctrl, &delay_scratch, 0, NULL};
+
+        uint32_t bus_us = conversions * ADC_SCAN_CONVERSION_US;
+        if(bus_us > longest_bus_us) {
+            longest_bus_us = bus_us;
+        }
+
+        debug("ADC scan bus %u: %u conversions, about %luus", bus_number, conversions, bus_us);
+    }
+
+    if(longest_bus_us > 1000000 / ADC_FRAME_RATE_HZ) {
+        warning("the ADC scan takes about %luus, which is longer than a frame at %uHz",
+                longest_bus_us, ADC_FRAME_RATE_HZ);
+    }
+
+    info("ADC scan built: %u slots, %u control blocks, about %luus per frame",
+         adc_scan_number_of_slots, b, longest_bus_us);
+}
+
+void adc_scan_backend_start_frame() {
+
+    buses_pending = (1u << ADC_NUMBER_OF_BUSES) - 1;
+
+    for(uint8_t i = 0; i < ADC_NUMBER_OF_BUSES; i++) {
+        dma_channel_set_read_addr(buses[i].control_channel, buses[i].first_block, true);
+    }
+}
+
+
+static void __isr adc_scan_spi_dma_irq_handler() {
+
+    bool finished_one = false;
+
+    for(uint8_t i = 0; i < ADC_NUMBER_OF_BUSES; i++) {
+        if(dma_channel_get_irq0_status(buses[i].worker_channel)) {
+            dma_channel_acknowledge_irq0(buses[i].worker_channel);
+            buses_pending &= ~(1u << i);
+            finished_one = true;
+        }
+    }
+
+    // Wait for every bus to be done with its part
+    if(!finished_one || buses_pending != 0) {
+        return;
+    }
+
+    memcpy(adc_scan_next_frame()->values, landing, sizeof(uint16_t) * adc_scan_number_of_slots);
+    adc_scan_frame_done_from_isr();
+}
+
+#endif
@@ -0,0 +1,231 @@
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "controller-config.h"
+
+#include "joystick/button_events.h"
+
+#include "logging/logging.h"
+
+typedef struct {
+    button_debounce_config config;
+    bool pressed;               // The debounced state
+    bool changing;              // The raw reads have started to disagree with it
+    uint8_t count;              // Integrator: how far along it is, 0 is released
+    uint64_t edge_us;           // When the button started to disagree
+    uint64_t locked_until_us;   // Lockout: ignore the button until this
+} button_debounce_state;
+
+static button_debounce_state buttons[MAX_NUMBER_OF_BUTTONS];
+
+// One writer, so the head only ever gets stored to, never read-modify-written by two cores
+static button_event ring[BUTTON_EVENT_QUEUE_LENGTH];
+static volatile uint32_t head = 0;
+
+static volatile button_event_listener listener = NULL;
+
+
+static void emit(uint8_t button, bool pressed, uint64_t timestamp_us) {
+
+    button_event *event = &ring[head & (BUTTON_EVENT_QUEUE_LENGTH - 1)];
+    event->timestamp_us = timestamp_us;
+    event->button = button;
+    event->pressed = pressed;
+
+    // The event has to be all there before anyone can see it
+    __dmb();
+    head = head + 1;
+
+    button_event_listener l = listener;
+    if(l != NULL) {
+        l(event);
+    }
+}
+
+void button_events_init() {
+
+    button_debounce_config config = {
+            .mode = BUTTON_DEBOUNCE_DEFAULT_MODE,
+            .samples = BUTTON_DEBOUNCE_SAMPLES,
+            .lockout_us = BUTTON_DEBOUNCE_LOCKOUT_US
+    };
+
+    memset(buttons, '\0', sizeof(buttons));
+    for(uint8_t i = 0; i < MAX_NUMBER_OF_BUTTONS; i++) {
+        button_debounce_configure(i, &config);
+    }
+
+    head = 0;
+
+    debug("button events set up, %d buttons, queue length %d", MAX_NUMBER_OF_BUTTONS, BUTTON_EVENT_QUEUE_LENGTH);
+}
+
+/**
+ * Change how a button is debounced. This resets the button's debouncer, but not its state.
+ */
+void button_debounce_configure(uint8_t button, const button_debounce_config *config) {
+
+    if(button >= MAX_NUMBER_OF_BUTTONS) {
+        warning("can't configure the debouncer on button %u, there's only %d", button, MAX_NUMBER_OF_BUTTONS);
+        return;
+    }
+
+    button_debounce_state *b = &buttons[button];
+    b->config = *config;
+
+    // An integrator that only needs one read is just the raw button
+    if(b->config.mode == BUTTON_DEBOUNCE_INTEGRATOR && b->config.samples == 0) {
+        b->config.samples = 1;
+    }
+
+    b->changing = false;
+    b->count = b->pressed ? b->config.samples : 0;
+    b->locked_until_us = 0;
+}
+
+/**
+ * @brief Runs one raw read of a button through its debouncer
+ *
+ * Only the button reader should call this, it's the one writer on the event queue.
+ *
+ * @param button which button
+ * @param raw_pressed what the button read just now
+ * @param raw_since_us when it started reading that way
+ * @param now_us when it was read
+ * @param sweep true if this is one of the regular sweeps, false if the scanner saw a change
+ * @return the debounced state of the button
+ */
+bool button_debounce_update(uint8_t button, bool raw_pressed, uint64_t raw_since_us, uint64_t now_us, bool sweep) {
+
+    button_debounce_state *b = &buttons[button];
+
+    if(b->config.mode == BUTTON_DEBOUNCE_LOCKOUT) {
+
+        if(now_us < b->locked_until_us || raw_pressed == b->pressed) {
+            return b->pressed;
+        }
+
+        b->pressed = raw_pressed;
+        b->locked_until_us = now_us + b->config.lockout_us;
+        emit(button, b->pressed, raw_since_us);
+
+        return b->pressed;
+    }
+
+    // Integrator. It counts reads, so it only looks at the sweeps or a bounce would count extra.
+    if(!sweep) {
+        return b->pressed;
+    }
+
+    if(raw_pressed) {
+        if(b->count < b->config.samples) {
+            b->count++;
+        }
+    }
+    else if(b->count > 0) {
+        b->count--;
+    }
+
+    // Remember when it started to move, and forget it if it bounced back
+    if(raw_pressed != b->pressed) {
+        if(!b->changing) {
+            b->changing = true;
+            b->edge_us = raw_since_us;
+        }
+    }
+    else if(b->count == (b->pressed ? b->config.samples : 0)) {
+        b->changing = false;
+    }
+
+    if(!b->pressed && b->count == b->config.samples) {
+        b->pressed = true;
+        b->changing = false;
+        emit(button, true, b->edge_us);
+    }
+    else if(b->pressed && b->count == 0) {
+        b->pressed = false;
+        b->changing = false;
+        emit(button, false, b->edge_us);
+    }
+
+    return b->pressed;
+}
+
+bool button_is_pressed(uint8_t button) {
+    return button < MAX_NUMBER_OF_BUTTONS && buttons[button].pressed;
+}
+
+/**
+ * Start reading from the queue. Only events that happen after this get seen.
+ */
+void button_event_cursor_init(button_event_cursor *cursor) {
+    cursor->next = head;
+    cursor->lost = 0;
+}
+
+/**
+ * @brief Look at the next event without taking it
+ *
+ * @param cursor where this reader is in the queue (in/out, it skips ahead if it fell behind)
+ * @param event where to put the event
+ * @return false if there's nothing new
+ */
+bool button_event_peek(button_event_cursor *cursor, button_event *event) {
+
+    for(;;) {
+
+        uint32_t written = head;
+        if(cursor->next == written) {
+            return false;
+        }
+
+        // The slot at head is the one being written, so there's one less than the whole ring to read
+        if(written - cursor->next >= BUTTON_EVENT_QUEUE_LENGTH) {
+            uint32_t oldest = written - (BUTTON_EVENT_QUEUE_LENGTH - 1);
+            cursor->lost += oldest - cursor->next;
+            cursor->next = oldest;
+        }
+
+        __dmb();
+        *event = ring[cursor->next & (BUTTON_EVENT_QUEUE_LENGTH - 1)];
+        __dmb();
+
+        // If the writer lapped us while we were copying, it might be half of two events
+        if(head - cursor->next < BUTTON_EVENT_QUEUE_LENGTH) {
+            return true;
+        }
+    }
+}
+
+/**
+ * Move past the event that peek just returned
+ */
+void button_event_pop(button_event_cursor *cursor) {
+    cursor->next++;
+}
+
+bool button_event_next(button_event_cursor *cursor, button_event *event) {
+
+    if(!button_event_peek(cursor, event)) {
+        return false;
+    }
+
+    button_event_pop(cursor);
+    return true;
+}
+
+/**
+ * How many events there have been since boot
+ */
+uint32_t button_events_written() {
+    return head;
+}
+
+/**
+ * Get called as soon as there's a new event. There's only room for one, and NULL turns it off.
+ */
+void button_events_set_listener(button_event_listener new_listener) {
+    listener = new_listener;
+}
@@ -0,0 +1,86 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "controller-config.h"
+
+/**
+ * Button debouncing and press/release events
+ *
+ * The button reader hands every raw read to button_debounce_update(), which runs that button's
+ * debouncer and turns clean changes into events. It reads on every sweep, and also whenever
+ * the scanner sees a change. Each button gets one of two debouncers:
+ *
+ *   Lockout    - changes state on the very first read that's different, then ignores the
+ *                button for `lockout_us`. Since the scanner wakes the reader, that's within
+ *                a scan of the edge. One glitch is a whole press, though.
+ *   Integrator - counts up while the button reads pressed and down while it reads released,
+ *                and changes state when the count hits either end. Quiet, but it only counts
+ *                sweeps, so it's `samples` sweeps after the edge before it changes.
+ *
+ * Either way an event is stamped with when the button started reading the way it does now,
+ * not when the debouncer made up its mind. The scanner knows that to within a scan, so the
+ * timing is a lot better than the sweep rate.
+ *
+ * The events go into a ring that anything can read from without locking. There's only ever
+ * the one writer (the button reader), and each reader keeps its own cursor, so the USB side
+ * and the lights see every event without taking them from each other. A reader that falls
+ * more than BUTTON_EVENT_QUEUE_LENGTH - 1 events behind loses the oldest ones, and that gets
+ * counted on its cursor.
+ *
+ * Anything that can't wait to poll the queue can also set a listener, which gets called right
+ * after each event goes in. It runs on the button reader, so it should just wake something up.
+ */
+
+#if (BUTTON_EVENT_QUEUE_LENGTH & (BUTTON_EVENT_QUEUE_LENGTH - 1)) != 0
+#error "BUTTON_EVENT_QUEUE_LENGTH has to be a power of two"
+#endif
+
+typedef enum {
+    BUTTON_DEBOUNCE_INTEGRATOR,
+    BUTTON_DEBOUNCE_LOCKOUT
+} button_debounce_mode;
+
+typedef struct {
+    button_debounce_mode mode;
+    uint8_t samples;            // Integrator: reads in a row it takes to change
+    uint32_t lockout_us;        // Lockout: how long to ignore the button after a change
+} button_debounce_config;
+
+typedef struct {
+    uint64_t timestamp_us;      // time_us_64() of when the button went this way
+    uint8_t button;
+    bool pressed;
+} button_event;
+
+typedef void (*button_event_listener)(const button_event *event);
+
+typedef struct {
+    uint32_t next;              // Sequence number of the next event to read
+    uint32_t lost;              // Events that got written over before they were read
+} button_event_cursor;
+
+void button_events_init();
+void button_debounce_configure(uint8_t button, const button_debounce_config *config);
+
+bool button_debounce_update(uint8_t button, bool raw_pressed, uint64_t raw_since_us, uint64_t now_us, bool sweep);
+bool button_is_pressed(uint8_t button);
+
+void button_event_cursor_init(button_event_cursor *cursor);
+bool button_event_peek(button_event_cursor *cursor, button_event *event);
+void button_event_pop(button_event_cursor *cursor);
+bool button_event_next(button_event_cursor *cursor, button_event *event);
+
+uint32_t button_events_written();
+void button_events_set_listener(button_event_listener listener);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,152 @@
+
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+
+#include "controller-config.h"
+
+#include "joystick/button_scan.h"
+
+#include "logging/logging.h"
+
+#include "button_mux.pio.h"
+
+static uint state_machine;
+
+// Straight off the pin, so a 1 is released. Nothing's pressed until the scanner says so.
+static volatile uint32_t last_scan = 0xFFFFFFFF;
+static uint64_t last_change_us[MAX_NUMBER_OF_BUTTONS];
+static volatile uint32_t changes = 0;
+static TaskHandle_t reader_task_handle = NULL;
+
+
+static void __isr button_scan_irq_handler();
+
+
+#if BUTTON_MUXES == 2
+/**
+ * The pair scanner interleaves the two muxes, so pull the even bits down into the bottom half
+ * and the odd ones into the top
+ */
+static inline uint32_t unzip(uint32_t scan) {
+
+    uint32_t even = scan & 0x55555555;
+    uint32_t odd = (scan >> 1) & 0x55555555;
+
+    even = (even | (even >> 1)) & 0x33333333;
+    even = (even | (even >> 2)) & 0x0F0F0F0F;
+    even = (even | (even >> 4)) & 0x00FF00FF;
+    even = (even | (even >> 8)) & 0x0000FFFF;
+
+    odd = (odd | (odd >> 1)) & 0x33333333;
+    odd = (odd | (odd >> 2)) & 0x0F0F0F0F;
+    odd = (odd | (odd >> 4)) & 0x00FF00FF;
+    odd = (odd | (odd >> 8)) & 0x0000FFFF;
+
+    return even | (odd << 16);
+}
+#endif
+
+
+/**
+ * @brief Start the scanner
+ *
+ * @param reader the task to wake up when something changes. The IRQ ends up on the core this
+ *        is called from, so call it from that task.
+ */
+void button_scan_init(TaskHandle_t reader) {
+
+    memset(last_change_us, '\0', sizeof(last_change_us));
+    reader_task_handle = reader;
+
+#if BUTTON_MUXES == 2
+    uint offset = pio_add_program(BUTTON_PIO, &button_mux_pair_program);
+#else
+    uint offset = pio_add_program(BUTTON_PIO, &button_mux_program);
+#endif
+    state_machine = pio_claim_unused_sm(BUTTON_PIO, true);
+
+    // Hear about it as soon as a scan is different
+    uint irq = pio_get_index(BUTTON_PIO) == 0 ? PIO0_IRQ_0 : PIO1_IRQ_0;
+    pio_set_irq0_source_enabled(BUTTON_PIO, pis_sm0_rx_fifo_not_empty + state_machine, true);
+    irq_add_shared_handler(irq, button_scan_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(irq, true);
+
+    button_mux_program_init(BUTTON_PIO, state_machine, offset, BUTTON_MUXES, BUTTON_MUX0, BUTTON_IN,
+                            BUTTON_SCAN_RATE_HZ);
+
+    // Make sure the mux gets enough time to settle at this rate
+    uint32_t pio_hz = BUTTON_SCAN_RATE_HZ * button_mux_CYCLES_PER_SCAN;
+    uint32_t settle_ns = (uint32_t)(((uint64_t)button_mux_SETTLE_CYCLES * 1000000000) / pio_hz);
+    if(settle_ns < BUTTON_MUX_SETTLE_NS) {
+        warning("the button mux only gets %luns to settle at %dHz, it needs %dns",
+                settle_ns, BUTTON_SCAN_RATE_HZ, BUTTON_MUX_SETTLE_NS);
+    }
+
+    info("button scanner on PIO state machine %u at %dHz, %d mux(es), %luns to settle",
+         state_machine, BUTTON_SCAN_RATE_HZ, BUTTON_MUXES, settle_ns);
+}
+
+/**
+ * @brief Where the buttons are right now
+ *
+ * @param changed_at_us when each button last changed (out)
+ * @return the buttons that are pressed
+ */
+button_t button_scan_read(uint64_t changed_at_us[MAX_NUMBER_OF_BUTTONS]) {
+
+    taskENTER_CRITICAL();
+    uint32_t scan = last_scan;
+    memcpy(changed_at_us, last_change_us, sizeof(last_change_us));
+    taskEXIT_CRITICAL();
+
+    return (button_t)~scan;
+}
+
+/**
+ * How many times the scanner's seen something change since boot, bounces and all
+ */
+uint32_t button_scan_changes() {
+    return changes;
+}
+
+
+/**
+ * Only runs when something changed, which with bouncing might still be a few in a row. The
+ * reader gets woken every time, and it's up to the debouncers what to make of it.
+ */
+static void __isr button_scan_irq_handler() {
+
+    UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+
+    while(!pio_sm_is_rx_fifo_empty(BUTTON_PIO, state_machine)) {
+
+        uint32_t scan = pio_sm_get(BUTTON_PIO, state_machine);
+#if BUTTON_MUXES == 2
+        scan = unzip(scan);
+#endif
+        uint32_t changed = scan ^ last_scan;
+        uint64_t now = time_us_64();
+
+        for(uint8_t i = 0; i < MAX_NUMBER_OF_BUTTONS; i++) {
+            if(changed & (1u << i)) {
+                last_change_us[i] = now;
+            }
+        }
+
+        last_scan = scan;
+        changes++;
+    }
+
+    taskEXIT_CRITICAL_FROM_ISR(saved);
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    xTaskNotifyFromISR(reader_task_handle, BUTTON_SCAN_CHANGED, eSetBits, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
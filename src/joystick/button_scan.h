@@ -0,0 +1,45 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "controller-config.h"
+
+/**
+ * Button scanning on the PIO
+ *
+ * A state machine walks the button mux on its own at BUTTON_SCAN_RATE_HZ, and only tells us
+ * about scans where something changed. Those come in on the PIO's IRQ, which notes when each
+ * button last changed and wakes the button reader right then with BUTTON_SCAN_CHANGED, so a
+ * press doesn't wait for the next sweep. The reader doesn't have to drive the mux or wait for
+ * it to settle anymore, it just picks up where everything is.
+ *
+ * Buttons 0-15 are the lines on the first mux, and 16-31 are the lines on the second one.
+ */
+
+// Every mux has 16 lines
+#define BUTTON_MUXES    ((MAX_NUMBER_OF_BUTTONS + 15) / 16)
+
+// What the button reader gets notified with when a scan's different
+#define BUTTON_SCAN_CHANGED     (1u << 1)
+
+#if (BUTTON_MUX1 != BUTTON_MUX0 + 1) || (BUTTON_MUX2 != BUTTON_MUX1 + 1) || (BUTTON_MUX3 != BUTTON_MUX2 + 1)
+#error "The button scanner needs BUTTON_MUX0..3 on consecutive pins"
+#endif
+
+void button_scan_init(TaskHandle_t reader);
+
+button_t button_scan_read(uint64_t changed_at_us[MAX_NUMBER_OF_BUTTONS]);
+uint32_t button_scan_changes();
+
+#ifdef __cplusplus
+}
+#endif
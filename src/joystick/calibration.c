@@ -0,0 +1,351 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <timers.h>
+
+#include "controller-config.h"
+
+#include "eeprom/eeprom.h"
+#include "joystick/calibration.h"
+#include "joystick/joystick.h"
+#include "tasks/tasks.h"
+#include "util/crc16.h"
+
+#include "logging/logging.h"
+
+extern uint8_t number_of_axen;
+extern axis* axis_collection[MAX_NUMBER_OF_AXEN];
+
+typedef enum {
+    CALIBRATION_IDLE,
+    CALIBRATION_CENTERING,
+    CALIBRATION_SWEEPING
+} calibration_state;
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint32_t center_sum;
+} calibration_capture;
+
+static volatile calibration_state state = CALIBRATION_IDLE;
+static calibration_capture captures[MAX_NUMBER_OF_AXEN];
+static uint32_t center_samples;
+static TimerHandle_t capture_timer = NULL;
+
+// Only one of these happens at a time, so they can share
+static uint8_t block[CALIBRATION_BLOCK_SIZE];
+
+// What calibration_save() hands the writer. Only touched in a critical section.
+static uint8_t pending_block[CALIBRATION_BLOCK_SIZE];
+static size_t pending_length = 0;
+
+static TaskHandle_t writer_task_handle = NULL;
+
+
+static void calibration_timer_callback(TimerHandle_t xTimer);
+portTASK_FUNCTION_PROTO(calibration_writer_task, pvParameters);
+
+
+static axis* find_axis(uint8_t adc_channel) {
+
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+        if(axis_collection[i]->adc_channel == adc_channel) {
+            return axis_collection[i];
+        }
+    }
+    return NULL;
+}
+
+void calibration_init() {
+
+    capture_timer = xTimerCreate("Calibration",
+                                 pdMS_TO_TICKS(CALIBRATION_SAMPLE_MS),
+                                 pdTRUE,
+                                 (void *) 0,
+                                 calibration_timer_callback);
+    configASSERT(capture_timer != NULL);
+
+    // Writing the EEPROM blocks for a while, so it gets its own task down at the bottom
+    xTaskCreateAffinitySet(calibration_writer_task,
+                           "calibration_writer",
+                           configMINIMAL_STACK_SIZE + 512,
+                           (void*)0,
+                           CALIBRATION_WRITER_TASK_PRIORITY,
+                           TASK_CORE_MASK(CALIBRATION_WRITER_TASK_CORE),
+                           &writer_task_handle);
+}
+
+/**
+ * Read the calibration out of the EEPROM and give it to the axes. Call this after every axis
+ * has been registered.
+ *
+ * @return true if there was a calibration to load
+ */
+bool calibration_load() {
+
+    eeprom_read(EEPROM_I2C_BUS, EEPROM_I2C_ADDR, EEPROM_CALIBRATION_ADDRESS, block, CALIBRATION_BLOCK_SIZE);
+
+    if(memcmp(block, CALIBRATION_MAGIC, CALIBRATION_MAGIC_SIZE) != 0) {
+        info("no calibration in the EEPROM, using the full range of every axis");
+        return false;
+    }
+
+    size_t offset = CALIBRATION_MAGIC_SIZE;
+    uint8_t version = block[offset++];
+    uint8_t count = block[offset++];
+
+    if(version != CALIBRATION_VERSION || count > MAX_NUMBER_OF_AXEN) {
+        error("don't know how to read calibration version %u with %u axes", version, count);
+        return false;
+    }
+
+    size_t records_end = offset + (count * CALIBRATION_RECORD_SIZE);
+    uint16_t stored_crc = (block[records_end] << 8) | block[records_end + 1];
+    if(crc16(block, records_end) != stored_crc) {
+        error("the calibration in the EEPROM is corrupt, using the full range of every axis");
+        return false;
+    }
+
+    uint8_t loaded = 0;
+    for(uint8_t i = 0; i < count; i++) {
+
+        const uint8_t *record = &block[offset + (i * CALIBRATION_RECORD_SIZE)];
+        uint8_t channel = record[0];
+        uint16_t min = (record[1] << 8) | record[2];
+        uint16_t center = (record[3] << 8) | record[4];
+        uint16_t max = (record[5] << 8) | record[6];
+
+        axis *a = find_axis(channel);
+        if(a == NULL) {
+            warning("there's a calibration for adc channel %u, but no axis on it", channel);
+            continue;
+        }
+
+        if(axis_set_calibration(a, min, center, max)) {
+            loaded++;
+        }
+    }
+
+    info("loaded the calibration for %u of %u axes", loaded, number_of_axen);
+    return true;
+}
+
+/**
+ * Start capturing. Leave the sticks alone for a moment so the centers can be found.
+ *
+ * @return false if a calibration's already going
+ */
+bool calibration_start() {
+
+    if(state != CALIBRATION_IDLE) {
+        warning("already calibrating");
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+        captures[i].min = UINT16_MAX;
+        captures[i].max = 0;
+        captures[i].center_sum = 0;
+    }
+    center_samples = 0;
+    state = CALIBRATION_CENTERING;
+    taskEXIT_CRITICAL();
+
+    xTimerStart(capture_timer, 0);
+
+    info("calibration started, finding the centers");
+    return true;
+}
+
+/**
+ * Stop capturing without changing anything
+ */
+void calibration_cancel() {
+
+    xTimerStop(capture_timer, 0);
+    state = CALIBRATION_IDLE;
+
+    info("calibration cancelled");
+}
+
+bool calibration_is_running() {
+    return state != CALIBRATION_IDLE;
+}
+
+/**
+ * Stop capturing, give the axes their new ranges, and have them written to the EEPROM
+ *
+ * An axis that didn't get swept far enough keeps the range it had. This gets called from the
+ * USB side, so the EEPROM write itself is left to the writer task.
+ *
+ * @return how many axes got a new range
+ */
+uint8_t calibration_save() {
+
+    if(state != CALIBRATION_SWEEPING) {
+        warning("can't save the calibration, %s", state == CALIBRATION_IDLE ? "it's not running" : "it's still finding the centers");
+        return 0;
+    }
+
+    xTimerStop(capture_timer, 0);
+
+    calibration_capture taken[MAX_NUMBER_OF_AXEN];
+    uint32_t samples;
+
+    taskENTER_CRITICAL();
+    memcpy(taken, captures, sizeof(taken));
+    samples = center_samples;
+    state = CALIBRATION_IDLE;
+    taskEXIT_CRITICAL();
+
+    uint8_t calibrated = 0;
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+
+        axis *a = axis_collection[i];
+        uint16_t min = taken[i].min;
+        uint16_t max = taken[i].max;
+
+        if(max < min || max - min < CALIBRATION_MIN_SPAN) {
+            warning("adc channel %u only moved %u counts, keeping its old calibration",
+                    a->adc_channel, max < min ? 0 : max - min);
+            continue;
+        }
+
+        // Something that doesn't spring back doesn't have a center worth keeping
+        uint16_t center = a->centered && samples > 0
+                ? (uint16_t)(taken[i].center_sum / samples)
+                : (uint16_t)((min + max) / 2);
+
+        if(axis_set_calibration(a, min, center, max)) {
+            calibrated++;
+        }
+    }
+
+    // Store what every axis is using now, not just the ones that changed
+    memcpy(block, CALIBRATION_MAGIC, CALIBRATION_MAGIC_SIZE);
+    size_t offset = CALIBRATION_MAGIC_SIZE;
+    block[offset++] = CALIBRATION_VERSION;
+    block[offset++] = number_of_axen;
+
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+        axis *a = axis_collection[i];
+        axis_calibration c = axis_get_calibration(a);
+        block[offset++] = a->adc_channel;
+        block[offset++] = c.min >> 8;
+        block[offset++] = c.min & 0xFF;
+        block[offset++] = c.center >> 8;
+        block[offset++] = c.center & 0xFF;
+        block[offset++] = c.max >> 8;
+        block[offset++] = c.max & 0xFF;
+    }
+
+    uint16_t crc = crc16(block, offset);
+    block[offset++] = crc >> 8;
+    block[offset++] = crc & 0xFF;
+
+    // If the last one hasn't been written yet, this one replaces it
+    taskENTER_CRITICAL();
+    memcpy(pending_block, block, offset);
+    pending_length = offset;
+    taskEXIT_CRITICAL();
+
+    xTaskNotifyGive(writer_task_handle);
+
+    info("calibrated %u of %u axes, saving", calibrated, number_of_axen);
+    return calibrated;
+}
+
+/**
+ * What an axis has now, or what's been captured for it so far if a calibration's going
+ */
+void calibration_describe_axis(uint8_t axis_number, char *buffer, size_t length) {
+
+    if(axis_number >= number_of_axen) {
+        snprintf(buffer, length, "no axis %u", axis_number);
+        return;
+    }
+
+    axis *a = axis_collection[axis_number];
+
+    if(state == CALIBRATION_IDLE) {
+        axis_calibration c = axis_get_calibration(a);
+        snprintf(buffer, length, "axis %u (channel %u): min %u, center %u, max %u",
+                 axis_number, a->adc_channel, c.min, c.center, c.max);
+    }
+    else {
+        snprintf(buffer, length, "axis %u (channel %u): now %u, seen %u to %u",
+                 axis_number, a->adc_channel, a->raw_value,
+                 captures[axis_number].min, captures[axis_number].max);
+    }
+}
+
+
+static void calibration_timer_callback(TimerHandle_t xTimer) {
+
+    bool found_centers = false;
+
+    taskENTER_CRITICAL();
+
+    if(state == CALIBRATION_CENTERING) {
+
+        for(uint8_t i = 0; i < number_of_axen; i++) {
+            captures[i].center_sum += axis_collection[i]->raw_value;
+        }
+
+        if(++center_samples >= CALIBRATION_CENTER_MS / CALIBRATION_SAMPLE_MS) {
+            state = CALIBRATION_SWEEPING;
+            found_centers = true;
+        }
+    }
+    else if(state == CALIBRATION_SWEEPING) {
+
+        for(uint8_t i = 0; i < number_of_axen; i++) {
+            uint16_t value = axis_collection[i]->raw_value;
+            if(value < captures[i].min) {
+                captures[i].min = value;
+            }
+            if(value > captures[i].max) {
+                captures[i].max = value;
+            }
+        }
+    }
+
+    taskEXIT_CRITICAL();
+
+    // Logging from inside the critical section isn't a good idea
+    if(found_centers) {
+        info("found the centers, sweep every axis from end to end and then save");
+    }
+}
+
+
+portTASK_FUNCTION(calibration_writer_task, pvParameters) {
+
+    uint8_t writing[CALIBRATION_BLOCK_SIZE];
+    size_t length;
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+    for(EVER) {
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        taskENTER_CRITICAL();
+        length = pending_length;
+        memcpy(writing, pending_block, length);
+        taskEXIT_CRITICAL();
+
+        if(eeprom_write(EEPROM_I2C_BUS, EEPROM_I2C_ADDR, EEPROM_CALIBRATION_ADDRESS, writing, length)) {
+            info("saved the calibration to the EEPROM");
+        }
+        else {
+            error("couldn't write the calibration to the EEPROM, it'll be gone after a reboot");
+        }
+    }
+#pragma clang diagnostic pop
+}
@@ -0,0 +1,52 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "controller-config.h"
+
+/**
+ * Calibration capture
+ *
+ * Finds out how far each axis actually goes, so a stick that only covers part of the ADC's
+ * range still makes it to both ends of the HID report.
+ *
+ *   1. calibration_start(): hands off the sticks. For the first CALIBRATION_CENTER_MS the
+ *      centered axes are averaged to find where they rest.
+ *   2. Then sweep everything from end to end as many times as you like. The lowest and
+ *      highest reading on every axis gets kept.
+ *   3. calibration_save(): the new ranges go to the axes right away, and into the EEPROM so
+ *      calibration_load() can put them back at boot.
+ *
+ * The calibration's stored in its own block at EEPROM_CALIBRATION_ADDRESS, away from the
+ * config block at the top. All values are big-endian:
+ *
+ *   "CAL!" | version | number of axes | (channel, min, center, max) per axis | CRC-16
+ */
+
+#define CALIBRATION_MAGIC           "CAL!"
+#define CALIBRATION_MAGIC_SIZE      4
+#define CALIBRATION_VERSION         1
+#define CALIBRATION_RECORD_SIZE     7
+#define CALIBRATION_BLOCK_SIZE      (CALIBRATION_MAGIC_SIZE + 2 + (MAX_NUMBER_OF_AXEN * CALIBRATION_RECORD_SIZE) + 2)
+
+void calibration_init();
+bool calibration_load();
+
+bool calibration_start();
+uint8_t calibration_save();
+void calibration_cancel();
+bool calibration_is_running();
+
+void calibration_describe_axis(uint8_t axis_number, char *buffer, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,116 @@
+
+#include "pico/stdlib.h"
+
+#include "controller-config.h"
+
+#include "joystick/controller_state.h"
+
+static controller_state copies[2];
+static volatile uint32_t sequence = 0;
+
+static volatile controller_state_listener listener = NULL;
+
+// Every snapshot, one writer like the button events
+static controller_state history[CONTROLLER_STATE_HISTORY_LENGTH];
+static volatile uint32_t history_head = 0;
+
+
+/**
+ * Put out a new snapshot. Only the analog reader should call this, there can only be one writer.
+ */
+void controller_state_publish(const controller_state *state) {
+
+    // Odd sends readers to copies[1] while copies[0] gets written...
+    sequence = sequence + 1;
+    __dmb();
+    copies[0] = *state;
+    __dmb();
+
+    // ...and even sends them back while copies[1] catches up
+    sequence = sequence + 1;
+    __dmb();
+    copies[1] = *state;
+    __dmb();
+
+    history[history_head & (CONTROLLER_STATE_HISTORY_LENGTH - 1)] = *state;
+    __dmb();
+    history_head = history_head + 1;
+
+    controller_state_listener l = listener;
+    if(l != NULL) {
+        l(state);
+    }
+}
+
+/**
+ * Get the latest snapshot
+ */
+void controller_state_read(controller_state *state) {
+
+    uint32_t started;
+
+    do {
+        started = sequence;
+        __dmb();
+        *state = copies[started & 1];
+        __dmb();
+    } while(sequence != started);
+}
+
+/**
+ * Get called as soon as there's a new snapshot. Same as the button events, there's only room
+ * for one, and NULL turns it off.
+ */
+void controller_state_set_listener(controller_state_listener new_listener) {
+    listener = new_listener;
+}
+
+/**
+ * Start reading the history. Only snapshots that come after this get seen.
+ */
+void controller_state_cursor_init(controller_state_cursor *cursor) {
+    cursor->next = history_head;
+    cursor->lost = 0;
+}
+
+/**
+ * How many snapshots are waiting to be read, counting ones that are about to be lost
+ */
+uint32_t controller_state_waiting(controller_state_cursor *cursor) {
+    return history_head - cursor->next;
+}
+
+/**
+ * @brief Take the oldest snapshot this reader hasn't seen yet
+ *
+ * @param cursor where this reader is in the history (in/out, it skips ahead if it fell behind)
+ * @param state where to put the snapshot
+ * @return false if there's nothing new
+ */
+bool controller_state_next(controller_state_cursor *cursor, controller_state *state) {
+
+    for(;;) {
+
+        uint32_t written = history_head;
+        if(cursor->next == written) {
+            return false;
+        }
+
+        // The slot at the head is the next one to be written, so leave it alone
+        if(written - cursor->next >= CONTROLLER_STATE_HISTORY_LENGTH) {
+            uint32_t oldest = written - (CONTROLLER_STATE_HISTORY_LENGTH - 1);
+            cursor->lost += oldest - cursor->next;
+            cursor->next = oldest;
+        }
+
+        __dmb();
+        *state = history[cursor->next & (CONTROLLER_STATE_HISTORY_LENGTH - 1)];
+        __dmb();
+
+        // If the writer lapped us while we were copying, it might be half of two snapshots
+        if(history_head - cursor->next < CONTROLLER_STATE_HISTORY_LENGTH) {
+            cursor->next++;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "controller-config.h"
+
+/**
+ * A snapshot of the whole controller from one ADC frame
+ *
+ * The analog reader publishes one of these at the end of every frame, and everything that
+ * shows or sends the controller's state reads it instead of picking at the axes one by one.
+ * That way a report never has half its axes from one frame and half from the next, even
+ * with the readers and the senders on different cores.
+ *
+ * There's no lock. It's two copies and a sequence number (a seqlock latch): while one copy is
+ * being written, readers are pointed at the other, and a reader only has to try again if the
+ * writer finished a whole copy while it was reading. A reader that interrupted the writer
+ * partway through still gets a clean copy, so it can't get stuck waiting for it.
+ *
+ * Like the button events, one listener can be told right after each snapshot goes out. It runs
+ * on the analog reader, so it should just wake something up.
+ *
+ * Every snapshot also goes into a history ring that works just like the button event queue:
+ * each reader has its own cursor, and one that falls more than
+ * CONTROLLER_STATE_HISTORY_LENGTH - 1 frames behind loses the oldest ones.
+ */
+
+#if (CONTROLLER_STATE_HISTORY_LENGTH & (CONTROLLER_STATE_HISTORY_LENGTH - 1)) != 0
+#error "CONTROLLER_STATE_HISTORY_LENGTH has to be a power of two"
+#endif
+
+// What the analog reader noticed about a frame
+#define CONTROLLER_STATE_FILTER_SLEEPING    (1u << 0)   // At least one axis's filter is asleep and holding its value
+#define CONTROLLER_STATE_CLIPPED            (1u << 1)   // At least one axis read at or past the ends of its calibration
+
+typedef struct {
+    uint32_t frame_number;                  // The ADC frame the axes came from
+    uint64_t timestamp_us;                  // When that frame was done
+    uint8_t number_of_axes;
+    uint16_t axes[MAX_NUMBER_OF_AXEN];      // Each axis's filtered_value, by axis index
+    button_t buttons;                       // Debounced, as of when the frame was published
+    uint8_t flags;                          // CONTROLLER_STATE_*
+} controller_state;
+
+typedef void (*controller_state_listener)(const controller_state *state);
+
+typedef struct {
+    uint32_t next;              // Sequence number of the next snapshot to read
+    uint32_t lost;              // Snapshots that got written over before they were read
+} controller_state_cursor;
+
+void controller_state_publish(const controller_state *state);
+void controller_state_read(controller_state *state);
+void controller_state_set_listener(controller_state_listener listener);
+
+void controller_state_cursor_init(controller_state_cursor *cursor);
+uint32_t controller_state_waiting(controller_state_cursor *cursor);
+bool controller_state_next(controller_state_cursor *cursor, controller_state *state);
+
+#ifdef __cplusplus
+}
+#endif
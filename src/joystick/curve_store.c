@@ -0,0 +1,184 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+
+#include "controller-config.h"
+
+#include "eeprom/eeprom.h"
+#include "joystick/calibration.h"
+#include "joystick/curve_store.h"
+#include "joystick/joystick.h"
+#include "util/crc16.h"
+
+#include "logging/logging.h"
+
+#if EEPROM_CALIBRATION_ADDRESS + CALIBRATION_BLOCK_SIZE > EEPROM_CURVES_ADDRESS
+#error "the calibration block runs into the response curves in the EEPROM"
+#endif
+
+extern uint8_t number_of_axen;
+extern axis* axis_collection[MAX_NUMBER_OF_AXEN];
+
+// What each axis asked for, so it can be shown later. The tables don't remember.
+static response_curve curves[MAX_NUMBER_OF_AXEN];
+
+static uint8_t block[CURVE_STORE_BLOCK_SIZE];
+
+
+static axis* find_axis(uint8_t adc_channel) {
+
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+        if(axis_collection[i]->adc_channel == adc_channel) {
+            return axis_collection[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Pull one record out of the block
+ *
+ * @return how many bytes it took up, or 0 if it doesn't fit in what's left
+ */
+static size_t unpack_record(const uint8_t *data, size_t len, uint8_t *channel, response_curve *curve) {
+
+    if(len < CURVE_STORE_RECORD_SIZE) {
+        return 0;
+    }
+
+    memset(curve, '\0', sizeof(response_curve));
+
+    *channel = data[0];
+    curve->center_deadzone = (data[1] << 8) | data[2];
+    curve->low_deadzone = (data[3] << 8) | data[4];
+    curve->high_deadzone = (data[5] << 8) | data[6];
+    curve->expo = data[7];
+    curve->number_of_points = data[8];
+
+    size_t size = CURVE_STORE_RECORD_SIZE + (curve->number_of_points * CURVE_STORE_POINT_SIZE);
+    if(curve->number_of_points > RESPONSE_CURVE_MAX_POINTS || len < size) {
+        return 0;
+    }
+
+    for(uint8_t i = 0; i < curve->number_of_points; i++) {
+        const uint8_t *point = &data[CURVE_STORE_RECORD_SIZE + (i * CURVE_STORE_POINT_SIZE)];
+        curve->points[i].x = (point[0] << 8) | point[1];
+        curve->points[i].y = (point[2] << 8) | point[3];
+    }
+
+    return size;
+}
+
+/**
+ * Whatever's in the block, checked all the way through before any of it gets used
+ *
+ * @return how many records there are, or -1 if the block's no good
+ */
+static int8_t check_block() {
+
+    if(memcmp(block, CURVE_STORE_MAGIC, CURVE_STORE_MAGIC_SIZE) != 0) {
+        info("no response curves in the EEPROM, using the defaults");
+        return -1;
+    }
+
+    size_t offset = CURVE_STORE_MAGIC_SIZE;
+    uint8_t version = block[offset++];
+    uint8_t count = block[offset++];
+
+    if(version != CURVE_STORE_VERSION || count > MAX_NUMBER_OF_AXEN) {
+        error("don't know how to read response curves version %u with %u axes", version, count);
+        return -1;
+    }
+
+    uint8_t channel;
+    response_curve curve;
+    for(uint8_t i = 0; i < count; i++) {
+        size_t size = unpack_record(&block[offset], sizeof(block) - 2 - offset, &channel, &curve);
+        if(size == 0) {
+            error("response curve %u in the EEPROM doesn't fit, using the defaults", i);
+            return -1;
+        }
+        offset += size;
+    }
+
+    uint16_t stored_crc = (block[offset] << 8) | block[offset + 1];
+    if(crc16(block, offset) != stored_crc) {
+        error("the response curves in the EEPROM are corrupt, using the defaults");
+        return -1;
+    }
+
+    return (int8_t)count;
+}
+
+/**
+ * Read the response curves out of the EEPROM and compile them into the axes. Call this after
+ * every axis has been registered.
+ *
+ * Axes that aren't in the EEPROM get the defaults from controller-config.h.
+ *
+ * @return true if there were curves to load
+ */
+bool curve_store_load() {
+
+    eeprom_read(EEPROM_I2C_BUS, EEPROM_I2C_ADDR, EEPROM_CURVES_ADDRESS, block, CURVE_STORE_BLOCK_SIZE);
+
+    bool stored[MAX_NUMBER_OF_AXEN] = {false};
+    int8_t count = check_block();
+
+    size_t offset = CURVE_STORE_MAGIC_SIZE + 2;
+    for(int8_t i = 0; i < count; i++) {
+
+        uint8_t channel;
+        response_curve curve;
+        offset += unpack_record(&block[offset], sizeof(block) - 2 - offset, &channel, &curve);
+
+        axis *a = find_axis(channel);
+        if(a == NULL) {
+            warning("there's a response curve for adc channel %u, but no axis on it", channel);
+            continue;
+        }
+
+        curves[a->index] = curve;
+        stored[a->index] = true;
+    }
+
+    uint8_t curved = 0;
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+
+        axis *a = axis_collection[i];
+
+        if(!stored[i]) {
+            memset(&curves[i], '\0', sizeof(response_curve));
+            curves[i].center_deadzone = a->centered ? RESPONSE_CURVE_DEFAULT_CENTER_DEADZONE : 0;
+            curves[i].expo = RESPONSE_CURVE_DEFAULT_EXPO;
+        }
+
+        if(axis_set_response_curve(a, &curves[i]) && a->response_curve != NULL) {
+            curved++;
+        }
+    }
+
+    info("%u of %u axes have a response curve, using %u tables", curved, number_of_axen,
+         response_curve_tables_in_use());
+    return count >= 0;
+}
+
+/**
+ * What curve an axis asked for, and whether it got a table for it
+ */
+void curve_store_describe_axis(uint8_t axis_number, char *buffer, size_t length) {
+
+    if(axis_number >= number_of_axen) {
+        snprintf(buffer, length, "no axis %u", axis_number);
+        return;
+    }
+
+    axis *a = axis_collection[axis_number];
+    response_curve *curve = &curves[axis_number];
+
+    snprintf(buffer, length, "axis %u (channel %u): center deadzone %u, edges %u/%u, expo %u%%, %u points, %s",
+             axis_number, a->adc_channel, curve->center_deadzone, curve->low_deadzone, curve->high_deadzone,
+             curve->expo, curve->number_of_points, a->response_curve == NULL ? "straight" : "table");
+}
@@ -0,0 +1,48 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "controller-config.h"
+
+#include "joystick/response_curve.h"
+
+/**
+ * Where the axes get their response curves from
+ *
+ * Like the config block, the curves are written to the EEPROM by the programmer, and
+ * curve_store_load() reads them back at boot and compiles them into the axes' tables. An
+ * axis that isn't in the block gets the defaults from controller-config.h.
+ *
+ * The block's at EEPROM_CURVES_ADDRESS. Records are keyed by ADC channel, and each one only
+ * has as many points as it uses. All values are big-endian:
+ *
+ *   "CRV!" | version | number of axes |
+ *      (channel, center deadzone, low deadzone, high deadzone, expo, number of points,
+ *       (x, y) per point) per axis |
+ *   CRC-16
+ */
+
+#define CURVE_STORE_MAGIC           "CRV!"
+#define CURVE_STORE_MAGIC_SIZE      4
+#define CURVE_STORE_VERSION         1
+#define CURVE_STORE_RECORD_SIZE     9       // Without the points
+#define CURVE_STORE_POINT_SIZE      4
+#define CURVE_STORE_BLOCK_SIZE      (CURVE_STORE_MAGIC_SIZE + 2 + \
+                                     (MAX_NUMBER_OF_AXEN * (CURVE_STORE_RECORD_SIZE + \
+                                     (RESPONSE_CURVE_MAX_POINTS * CURVE_STORE_POINT_SIZE))) + 2)
+
+bool curve_store_load();
+
+void curve_store_describe_axis(uint8_t axis_number, char *buffer, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
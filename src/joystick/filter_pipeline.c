@@ -0,0 +1,295 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/platform.h"
+
+#include "logging/logging.h"
+
+#include "joystick/filter_pipeline.h"
+
+#define VALUE_SHIFT     12
+#define GAIN_ONE        (1 << 16)
+
+static uint16_t median3_update(filter_stage *stage, uint16_t value);
+static uint16_t one_euro_update(filter_stage *stage, uint16_t value);
+static uint16_t kalman_update(filter_stage *stage, uint16_t value);
+static uint16_t responsive_update(filter_stage *stage, uint16_t value);
+
+
+/**
+ * Multiply a Q20.12 value by a Q16 gain
+ */
+static inline int32_t apply_gain(int32_t value, uint32_t gain) {
+    return (int32_t)(((int64_t)value * gain) >> 16);
+}
+
+/**
+ * Back from Q20.12 to a 16 bit axis value
+ */
+static inline uint16_t to_axis_value(int32_t value) {
+
+    value >>= VALUE_SHIFT;
+
+    if(value < 0) {
+        return 0;
+    }
+    if(value > UINT16_MAX) {
+        return UINT16_MAX;
+    }
+    return (uint16_t)value;
+}
+
+static filter_stage* next_stage(filter_pipeline *pipeline) {
+
+    if(pipeline->number_of_stages >= FILTER_PIPELINE_MAX_STAGES) {
+        warning("can't have more than %d filter stages on one axis", FILTER_PIPELINE_MAX_STAGES);
+        return NULL;
+    }
+
+    filter_stage *stage = &pipeline->stages[pipeline->number_of_stages++];
+    memset(stage, '\0', sizeof(filter_stage));
+    return stage;
+}
+
+
+void filter_pipeline_init(filter_pipeline *pipeline) {
+    memset(pipeline, '\0', sizeof(filter_pipeline));
+    pipeline->bank_stage = FILTER_PIPELINE_NO_BANK_STAGE;
+}
+
+bool filter_pipeline_add_median3(filter_pipeline *pipeline) {
+
+    filter_stage *stage = next_stage(pipeline);
+    if(stage == NULL) {
+        return false;
+    }
+
+    stage->update = median3_update;
+
+    debug("added a median3 filter stage");
+    return true;
+}
+
+/**
+ * @param min_cutoff_hz cutoff when the axis is still. Lower is less jitter, more lag.
+ * @param beta how much the cutoff goes up per count per second of speed. Higher is less lag.
+ * @param d_cutoff_hz cutoff for the speed estimate
+ */
+bool filter_pipeline_add_one_euro(filter_pipeline *pipeline, float min_cutoff_hz, float beta, float d_cutoff_hz) {
+
+    filter_stage *stage = next_stage(pipeline);
+    if(stage == NULL) {
+        return false;
+    }
+
+    one_euro_state *s = &stage->one_euro;
+    s->min_cutoff = (uint32_t)(min_cutoff_hz * GAIN_ONE);
+    s->beta = (uint32_t)(beta * GAIN_ONE);
+    s->two_pi_te = (uint32_t)((2.0f * 3.14159265f / ADC_FRAME_RATE_HZ) * GAIN_ONE);
+
+    // alpha = r / (r + 1), where r = 2 pi fc Te
+    float r = 2.0f * 3.14159265f * d_cutoff_hz / ADC_FRAME_RATE_HZ;
+    s->d_alpha = (uint32_t)((r / (r + 1.0f)) * GAIN_ONE);
+
+    stage->update = one_euro_update;
+
+    debug("added a one euro filter stage (Q16 min cutoff %lu, beta %lu)", s->min_cutoff, s->beta);
+    return true;
+}
+
+/**
+ * @param process_noise how far the axis can wander per frame, in counts squared
+ * @param measurement_noise the ADC's noise, in counts squared
+ */
+bool filter_pipeline_add_kalman(filter_pipeline *pipeline, float process_noise, float measurement_noise) {
+
+    filter_stage *stage = next_stage(pipeline);
+    if(stage == NULL) {
+        return false;
+    }
+
+    kalman_state *s = &stage->kalman;
+    s->q = (uint32_t)(process_noise * 256.0f);
+    s->r = (uint32_t)(measurement_noise * 256.0f);
+
+    stage->update = kalman_update;
+
+    debug("added a kalman filter stage (Q8 q %lu, r %lu)", s->q, s->r);
+    return true;
+}
+
+bool filter_pipeline_add_responsive(filter_pipeline *pipeline, analog_filter filter) {
+
+    if(pipeline->bank_stage != FILTER_PIPELINE_NO_BANK_STAGE) {
+        warning("an axis can only have one responsive filter stage");
+        return false;
+    }
+
+    filter_stage *stage = next_stage(pipeline);
+    if(stage == NULL) {
+        return false;
+    }
+
+    stage->responsive = filter;
+    stage->update = responsive_update;
+    pipeline->bank_stage = pipeline->number_of_stages - 1;
+
+    debug("added a responsive filter stage (bank slot %u)", filter.slot);
+    return true;
+}
+
+
+/**
+ * Run the stages up to the responsive one and stage its input in the bank. Without a
+ * responsive stage this runs the whole thing.
+ */
+void filter_pipeline_stage_input(filter_pipeline *pipeline, uint16_t value) {
+
+    uint8_t stop = pipeline->bank_stage != FILTER_PIPELINE_NO_BANK_STAGE
+            ? pipeline->bank_stage
+            : pipeline->number_of_stages;
+
+    for(uint8_t i = 0; i < stop; i++) {
+        value = pipeline->stages[i].update(&pipeline->stages[i], value);
+    }
+
+    if(stop < pipeline->number_of_stages) {
+        analog_filter_set_input(&pipeline->stages[stop].responsive, value);
+    }
+
+    pipeline->value = value;
+}
+
+/**
+ * Pick up the output of the bank and run whatever comes after it
+ */
+uint16_t filter_pipeline_finish(filter_pipeline *pipeline) {
+
+    if(pipeline->bank_stage == FILTER_PIPELINE_NO_BANK_STAGE) {
+        return pipeline->value;
+    }
+
+    uint16_t value = analog_filter_get_value(&pipeline->stages[pipeline->bank_stage].responsive);
+
+    for(uint8_t i = pipeline->bank_stage + 1; i < pipeline->number_of_stages; i++) {
+        value = pipeline->stages[i].update(&pipeline->stages[i], value);
+    }
+
+    pipeline->value = value;
+    return value;
+}
+
+/**
+ * Run the whole chain right now, updating the responsive stage on its own
+ */
+uint16_t filter_pipeline_update(filter_pipeline *pipeline, uint16_t value) {
+
+    for(uint8_t i = 0; i < pipeline->number_of_stages; i++) {
+        value = pipeline->stages[i].update(&pipeline->stages[i], value);
+    }
+
+    pipeline->value = value;
+    return value;
+}
+
+uint16_t filter_pipeline_get_value(filter_pipeline *pipeline) {
+    return pipeline->value;
+}
+
+
+/*
+ * The stages
+ */
+
+static uint16_t __not_in_flash_func(median3_update)(filter_stage *stage, uint16_t value) {
+
+    median3_state *s = &stage->median3;
+
+    if(!s->primed) {
+        s->history[0] = value;
+        s->history[1] = value;
+        s->primed = true;
+    }
+
+    uint16_t a = s->history[0];
+    uint16_t b = s->history[1];
+    uint16_t c = value;
+
+    s->history[0] = b;
+    s->history[1] = c;
+
+    // Median of three without sorting
+    if(a > b) {
+        uint16_t t = a;
+        a = b;
+        b = t;
+    }
+    return c <= a ? a : (c >= b ? b : c);
+}
+
+static uint16_t __not_in_flash_func(one_euro_update)(filter_stage *stage, uint16_t value) {
+
+    one_euro_state *s = &stage->one_euro;
+    int32_t x = (int32_t)value << VALUE_SHIFT;
+
+    if(!s->primed) {
+        s->x_hat = x;
+        s->dx_hat = 0;
+        s->primed = true;
+        return value;
+    }
+
+    // How fast it's moving, smoothed with the fixed derivative cutoff
+    int32_t dx = (int32_t)(((int64_t)(x - s->x_hat) * ADC_FRAME_RATE_HZ) >> VALUE_SHIFT);
+    s->dx_hat += (int32_t)(((int64_t)(dx - s->dx_hat) * s->d_alpha) >> 16);
+
+    // The faster it moves, the higher the cutoff
+    uint64_t cutoff = s->min_cutoff + (uint64_t)s->beta * (uint32_t)abs(s->dx_hat);
+    uint64_t r = (cutoff * s->two_pi_te) >> 16;
+    if(r > INT32_MAX) {
+        r = INT32_MAX;
+    }
+
+    // alpha = r / (r + 1) = 1 - 1 / (r + 1)
+    uint32_t alpha = GAIN_ONE - (uint32_t)(UINT32_MAX / ((uint32_t)r + GAIN_ONE));
+
+    s->x_hat += apply_gain(x - s->x_hat, alpha);
+    return to_axis_value(s->x_hat);
+}
+
+static uint16_t __not_in_flash_func(kalman_update)(filter_stage *stage, uint16_t value) {
+
+    kalman_state *s = &stage->kalman;
+    int32_t z = (int32_t)value << VALUE_SHIFT;
+
+    if(!s->primed) {
+        s->x_hat = z;
+        s->p = s->r;
+        s->primed = true;
+        return value;
+    }
+
+    // Predict. The position doesn't change, it just gets less certain.
+    s->p += s->q;
+
+    // Gain is p / (p + r) in Q16. Shift both down until the denominator fits in 16 bits so
+    // the numerator stays in 32.
+    uint32_t den = s->p + s->r;
+    uint32_t shift = 0;
+    if(den > UINT16_MAX) {
+        shift = 16 - __builtin_clz(den);
+    }
+    uint32_t gain = den == 0 ? GAIN_ONE : ((s->p >> shift) << 16) / (den >> shift);
+
+    // Update
+    s->x_hat += apply_gain(z - s->x_hat, gain);
+    s->p -= (uint32_t)(((uint64_t)s->p * gain) >> 16);
+
+    return to_axis_value(s->x_hat);
+}
+
+static uint16_t responsive_update(filter_stage *stage, uint16_t value) {
+    analog_filter_update(&stage->responsive, value);
+    return analog_filter_get_value(&stage->responsive);
+}
@@ -0,0 +1,106 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "controller-config.h"
+
+#include "joystick/responsive_analog_read_filter.h"
+
+/**
+ * A chain of filter stages for one axis
+ *
+ * Values go through the stages in the order they were added. All of the state lives in the
+ * pipeline itself, so there's no heap, and an axis can carry its pipeline around by value.
+ * Every stage costs the same on every update, no matter what the input does:
+ *
+ *   median3     - two compares and a swap. Throws out single-sample spikes, one frame of lag.
+ *   one euro    - three 32x32->64 multiplies and one divide. Smooth when still, snappy when
+ *                 moving. min_cutoff sets the jitter when still, beta how fast it opens up.
+ *   kalman      - two 32x32->64 multiplies and one divide. A constant-position 1-D Kalman,
+ *                 tuned with the process and measurement noise (16 bit counts squared).
+ *   responsive  - the ResponsiveAnalogRead port, run from its filter bank.
+ *
+ * The responsive stage is special. The reader task updates every axis's responsive filter in
+ * one pass over the bank, so a pipeline gets run in two halves around that:
+ * filter_pipeline_stage_input() runs everything up to the responsive stage and stages its
+ * input, and filter_pipeline_finish() picks up the bank's output and runs the rest. A
+ * pipeline can only have one responsive stage.
+ *
+ * Only change a pipeline before the reader task starts, or from the reader task itself.
+ */
+
+// Starting points for the stages, in 16 bit axis counts
+#define ONE_EURO_DEFAULT_MIN_CUTOFF_HZ      1.0f
+#define ONE_EURO_DEFAULT_BETA               0.0005f
+#define ONE_EURO_DEFAULT_D_CUTOFF_HZ        1.0f
+#define KALMAN_DEFAULT_PROCESS_NOISE        16.0f
+#define KALMAN_DEFAULT_MEASUREMENT_NOISE    256.0f
+
+#define FILTER_PIPELINE_NO_BANK_STAGE       0xFF
+
+typedef struct filter_stage filter_stage;
+typedef uint16_t (*filter_stage_update_fn)(filter_stage *stage, uint16_t value);
+
+typedef struct {
+    uint16_t history[2];
+    bool primed;
+} median3_state;
+
+typedef struct {
+    int32_t x_hat;              // Q20.12
+    int32_t dx_hat;             // counts per second
+    uint32_t min_cutoff;        // Hz, Q16
+    uint32_t beta;              // Hz per count per second, Q16
+    uint32_t d_alpha;           // Q16, the derivative's cutoff never changes
+    uint32_t two_pi_te;         // 2 pi times the frame period, Q16
+    bool primed;
+} one_euro_state;
+
+typedef struct {
+    int32_t x_hat;              // Q20.12
+    uint32_t p;                 // Estimate variance, Q8
+    uint32_t q;                 // Process noise, Q8
+    uint32_t r;                 // Measurement noise, Q8
+    bool primed;
+} kalman_state;
+
+struct filter_stage {
+    filter_stage_update_fn update;
+    union {
+        median3_state median3;
+        one_euro_state one_euro;
+        kalman_state kalman;
+        analog_filter responsive;
+    };
+};
+
+typedef struct {
+    uint8_t number_of_stages;
+    uint8_t bank_stage;         // Which stage is the responsive one, if any
+    uint16_t value;
+    filter_stage stages[FILTER_PIPELINE_MAX_STAGES];
+} filter_pipeline;
+
+
+void filter_pipeline_init(filter_pipeline *pipeline);
+
+bool filter_pipeline_add_median3(filter_pipeline *pipeline);
+bool filter_pipeline_add_one_euro(filter_pipeline *pipeline, float min_cutoff_hz, float beta, float d_cutoff_hz);
+bool filter_pipeline_add_kalman(filter_pipeline *pipeline, float process_noise, float measurement_noise);
+bool filter_pipeline_add_responsive(filter_pipeline *pipeline, analog_filter filter);
+
+void filter_pipeline_stage_input(filter_pipeline *pipeline, uint16_t value);
+uint16_t filter_pipeline_finish(filter_pipeline *pipeline);
+uint16_t filter_pipeline_update(filter_pipeline *pipeline, uint16_t value);
+uint16_t filter_pipeline_get_value(filter_pipeline *pipeline);
+
+#ifdef __cplusplus
+}
+#endif
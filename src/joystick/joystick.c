@@ -5,11 +5,20 @@
 #include "controller-config.h"
 
 #include "joystick/adc.h"
+#include "joystick/adc_scan.h"
+#include "joystick/button_events.h"
+#include "joystick/button_scan.h"
+#include "joystick/controller_state.h"
 #include "joystick/joystick.h"
+#include "joystick/sample_clock.h"
 
 #include "logging/logging.h"
+#include "tasks/tasks.h"
 
 
+// How much bigger an axis value is than an ADC count
+#define AXIS_VALUE_SCALE    ((AXIS_VALUE_MAX + 1) / (ADC_MAX_VALUE + 1))
+
 // Keep track of the number of axis we read
 uint8_t number_of_axen;
 axis* axis_collection[MAX_NUMBER_OF_AXEN];
@@ -19,52 +28,21 @@ axis* axis_collection[MAX_NUMBER_OF_AXEN];
 // device report
 button_t button_state_mask = 0;
 
-/**
- * This is an array of masks for the MUX for the buttons
- *
- * Right now only 0-7 are actually being used, but it doesn't hurt to add them all for later.
- */
-const uint32_t BUTTON_MUX_MASKS[16] = {
-        0, // 0000 - All lines off
-        GPIO_MASK(BUTTON_MUX0), // 0001 - Line 0 on
-        GPIO_MASK(BUTTON_MUX1), // 0010 - Line 1 on
-        GPIO_MASK(BUTTON_MUX0) | GPIO_MASK(BUTTON_MUX1), // 0011 - Lines 0 and 1 on
-        GPIO_MASK(BUTTON_MUX2), // 0100 - Line 2 on
-        GPIO_MASK(BUTTON_MUX2) | GPIO_MASK(BUTTON_MUX0), // 0101 - Lines 2 and 0 on
-        GPIO_MASK(BUTTON_MUX2) | GPIO_MASK(BUTTON_MUX1), // 0110 - Lines 2 and 1 on
-        GPIO_MASK(BUTTON_MUX2) | GPIO_MASK(BUTTON_MUX1) | GPIO_MASK(BUTTON_MUX0), // 0111 - Lines 2, 1, and 0 on
-        GPIO_MASK(BUTTON_MUX3), // 1000 - Line 3 on
-        GPIO_MASK(BUTTON_MUX3) | GPIO_MASK(BUTTON_MUX0), // 1001 - Lines 3 and 0 on
-        GPIO_MASK(BUTTON_MUX3) | GPIO_MASK(BUTTON_MUX1), // 1010 - Lines 3 and 1 on
-        GPIO_MASK(BUTTON_MUX3) | GPIO_MASK(BUTTON_MUX1) | GPIO_MASK(BUTTON_MUX0), // 1011 - Lines 3, 1, and 0 on
-        GPIO_MASK(BUTTON_MUX3) | GPIO_MASK(BUTTON_MUX2), // 1100 - Lines 3 and 2 on
-        GPIO_MASK(BUTTON_MUX3) | GPIO_MASK(BUTTON_MUX2) | GPIO_MASK(BUTTON_MUX0), // 1101 - Lines 3, 2, and 0 on
-        GPIO_MASK(BUTTON_MUX3) | GPIO_MASK(BUTTON_MUX2) | GPIO_MASK(BUTTON_MUX1), // 1110 - Lines 3, 2, and 1 on
-        GPIO_MASK(BUTTON_MUX3) | GPIO_MASK(BUTTON_MUX2) | GPIO_MASK(BUTTON_MUX1) | GPIO_MASK(BUTTON_MUX0)  // 1111 - All lines on
-};
-
-const uint32_t BUTTON_GPIO_MASK = BUTTON_MUX_MASKS[15];
+// The sample clock wakes this one up
+static TaskHandle_t button_reader_task_handle = NULL;
 
 void init_reader() {
 
     number_of_axen = 0;
 
+    // Every axis's filter goes in here
+    analog_filter_bank_init(&analog_filter_default_bank);
+
     // Wipe out our axis collection
     memset(axis_collection, '\0', sizeof(axis*) * MAX_NUMBER_OF_AXEN);
     debug("created the array of axen");
 
-    // Set up all of the pins on the MUX
-    for( int i = BUTTON_MUX0; i <= BUTTON_MUX3; i++) {
-        gpio_set_function(i, GPIO_FUNC_SIO);
-        gpio_set_dir(i, 1);
-        gpio_pull_up(i);
-    }
-
-    // ...and the button input pin
-    gpio_set_function(BUTTON_IN, GPIO_FUNC_SIO);
-    gpio_set_dir(BUTTON_IN, 0);
-
-    debug("configured the MUX and button input GPIO pins");
+    button_events_init();
 }
 
 void register_axis(axis* a) {
@@ -74,6 +52,7 @@ void register_axis(axis* a) {
         tight_loop_contents();
     }
 
+    a->index = number_of_axen;
     axis_collection[number_of_axen] = a;
     number_of_axen++;
     debug("registered new axis on channel %d. total number: %d", a->adc_channel, number_of_axen);
@@ -82,57 +61,233 @@ void register_axis(axis* a) {
 /**
  * @brief Reads a value on an axis from the hardware
  *
+ * This does a blocking read of the ADC. The reader task gets its values from the
+ * scan engine instead.
+ *
  * @param a the axis to check (in/out)
- * @param read_mode which mode should we be in?
  */
 void read_value(axis* a) {
 
-    uint16_t read_value = joystick_read_adc(a->adc_channel);
+    uint32_t sum = 0;
+    for(uint8_t i = 0; i < a->oversample; i++) {
+        sum += joystick_read_adc(a->adc_channel);
+    }
+
+    update_axis(a, decimate_samples(sum, a->oversample));
+}
+
+/**
+ * @brief Averages a burst of ADC readings into one AXIS_VALUE_BITS value
+ *
+ * Full scale on the ADC comes out as full scale on the axis. With enough conversions the
+ * noise dithers the result, so the extra bits mean something.
+ *
+ * @param sum all of the readings added up
+ * @param conversions how many readings there were
+ */
+uint16_t decimate_samples(uint32_t sum, uint8_t conversions) {
+    return (uint16_t)(((uint64_t)sum * AXIS_VALUE_MAX) / ((uint32_t)ADC_MAX_VALUE * conversions));
+}
+
+/**
+ * @brief Inverts a new reading for an axis and stretches it out to full scale
+ *
+ * Anything past the calibrated ends is pinned to them, since a stick that reaches a little
+ * further than it did while it was being calibrated is normal.
+ *
+ * @param a the axis the reading is for (in/out)
+ * @param new_value the reading, already scaled up to AXIS_VALUE_BITS
+ * @return the value to give the filter
+ */
+static uint16_t condition_reading(axis* a, uint16_t new_value) {
+
+    uint16_t read_value = new_value;
 
     if(a->inverted) {
-        read_value = a->adc_max - read_value;
+        read_value = AXIS_VALUE_MAX - read_value;
     }
 
     // Update the raw value
     a->raw_value = read_value;
 
-    if(read_value > a->adc_max) {
-        warning("clipping adc channel %d reading at %d (was %d)",
-                a->adc_channel, a->adc_max, read_value);
-        read_value = a->adc_max;
+    // Pick up a new calibration all at once, never part of one
+    if(a->calibration_staged) {
+        taskENTER_CRITICAL();
+        a->calibration = a->staged_calibration;
+        a->calibration_staged = false;
+        taskEXIT_CRITICAL();
+    }
+
+    const axis_calibration *c = &a->calibration;
+
+    if(read_value <= c->min) {
+        return 0;
+    }
+    if(read_value >= c->max) {
+        return AXIS_VALUE_MAX;
     }
 
-    if(read_value < a->adc_min) {
-        warning("clipping adc channel %d reading at %d (was %d)",
-                a->adc_channel, a->adc_min, read_value);
-        read_value = a->adc_min;
+    uint32_t scaled;
+    if(read_value < c->center) {
+        scaled = ((uint32_t)(read_value - c->min) * c->scale_low) >> 16;
+    }
+    else {
+        scaled = AXIS_VALUE_CENTER + (((uint32_t)(read_value - c->center) * c->scale_high) >> 16);
     }
 
-    // Update the filter
-    analog_filter_update(&a->filter, read_value);
+    return scaled > AXIS_VALUE_MAX ? AXIS_VALUE_MAX : (uint16_t)scaled;
+}
+
+/**
+ * @brief Puts what came out of the filter pipeline through the axis's curve and stores it
+ *
+ * @param a the axis to update (in/out)
+ * @param filter_value the pipeline's output
+ */
+static void publish_filtered_value(axis* a, uint16_t filter_value) {
+
+    filter_value = response_curve_apply(a->response_curve, filter_value);
+
+    // Cut it down to what the HID report carries
+    a->filtered_value = filter_value >> (AXIS_VALUE_BITS - HID_AXIS_BITS);
 
-    // Get the filter's current value
-    uint16_t filter_value = analog_filter_get_value(&a->filter);
+    verbose("read adc %d - raw: %d, filtered: %d, hid: %d",
+            a->adc_channel, a->raw_value, filter_value, a->filtered_value);
+}
 
-    // Convert this to an 8-bit value
-    a->filtered_value = (uint8_t)(filter_value >> 4);
+/**
+ * @brief Feeds a new reading from the ADC into an axis
+ *
+ * This runs the axis's whole pipeline on its own. The reader task updates the filter bank
+ * for every axis at once instead.
+ *
+ * @param a the axis to update (in/out)
+ * @param new_value the reading, already scaled up to AXIS_VALUE_BITS
+ */
+void update_axis(axis* a, uint16_t new_value) {
 
-    verbose("read adc %d - raw: %d, filtered: %d, 8-bit: %d",
-            a->adc_channel,read_value, filter_value, a->filtered_value);
+    publish_filtered_value(a, filter_pipeline_update(&a->pipeline, condition_reading(a, new_value)));
 }
 
 
-axis create_axis(uint8_t adc_channel) {
+static axis_calibration make_calibration(uint16_t min, uint16_t center, uint16_t max) {
+
+    axis_calibration c;
+    c.min = min;
+    c.center = center;
+    c.max = max;
+    c.scale_low = ((uint32_t)AXIS_VALUE_CENTER << 16) / (center - min);
+    c.scale_high = ((uint32_t)(AXIS_VALUE_MAX - AXIS_VALUE_CENTER) << 16) / (max - center);
+    return c;
+}
+
+/**
+ * @brief Sets the range an axis actually covers
+ *
+ * min reads as 0, center as AXIS_VALUE_CENTER, and max as AXIS_VALUE_MAX, with each half
+ * stretched out on its own. Everything's in AXIS_VALUE_BITS, after inverting.
+ *
+ * The reader's on the other core, so this doesn't touch what it's using. The new calibration
+ * gets staged, and the reader swaps it in whole before its next reading.
+ *
+ * @param a the axis (in/out)
+ * @return false if the range doesn't make sense, in which case the axis isn't changed
+ */
+bool axis_set_calibration(axis* a, uint16_t min, uint16_t center, uint16_t max) {
+
+    if(!(min < center && center < max)) {
+        warning("adc channel %u can't be calibrated to %u/%u/%u", a->adc_channel, min, center, max);
+        return false;
+    }
+
+    axis_calibration c = make_calibration(min, center, max);
+
+    taskENTER_CRITICAL();
+    a->staged_calibration = c;
+    a->calibration_staged = true;
+    taskEXIT_CRITICAL();
+
+    debug("calibrated adc channel %u to %u/%u/%u", a->adc_channel, min, center, max);
+    return true;
+}
+
+/**
+ * @brief The calibration an axis has, counting one the reader hasn't picked up yet
+ */
+axis_calibration axis_get_calibration(axis* a) {
+
+    axis_calibration c;
+
+    taskENTER_CRITICAL();
+    c = a->calibration_staged ? a->staged_calibration : a->calibration;
+    taskEXIT_CRITICAL();
+
+    return c;
+}
+
+/**
+ * @brief Gives an axis a response curve
+ *
+ * The curve gets compiled into a lookup table here, so do this when the config loads and not
+ * while the axis is running.
+ *
+ * @param a the axis (in/out)
+ * @param curve the curve to use
+ * @return true if the axis got the curve, false if it's stuck with a straight line
+ */
+bool axis_set_response_curve(axis* a, const response_curve* curve) {
+
+    if(!response_curve_compile(curve, &a->response_curve)) {
+        warning("adc channel %u didn't get its response curve", a->adc_channel);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Makes a new axis
+ *
+ * @param adc_channel the channel (0-15) it's wired to
+ * @param oversample how many conversions to average each frame (1 to ADC_MAX_OVERSAMPLE)
+ */
+axis create_axis(uint8_t adc_channel, uint8_t oversample) {
+
+    if(oversample < 1 || oversample > ADC_MAX_OVERSAMPLE) {
+        warning("can't oversample channel %u %u times, using %u", adc_channel, oversample, ADC_DEFAULT_OVERSAMPLE);
+        oversample = ADC_DEFAULT_OVERSAMPLE;
+    }
+
     axis a;
     a.adc_channel = adc_channel;
+    a.oversample = oversample;
+    a.scan_slot = 0;
     a.raw_value = 0;
     a.filtered_value = 0;
-    a.adc_max = 4095;       // We're using 12 bit ADCs
-    a.adc_min = 0;
     a.inverted = false;
-    a.filter = create_analog_filter(true, (float)ANALOG_READ_FILTER_SNAP_VALUE);
+    a.centered = false;
+    a.response_curve = NULL;
+
+    // The whole range until there's a calibration for it
+    a.calibration = make_calibration(0, AXIS_VALUE_CENTER, AXIS_VALUE_MAX);
+    a.calibration_staged = false;
+
+    // The filter was tuned on 12 bit values, so scale its knobs to match
+    a.filter = create_analog_filter(true, (float)ANALOG_READ_FILTER_SNAP_VALUE / AXIS_VALUE_SCALE);
+    analog_filter_set_analog_resolution(&a.filter, AXIS_VALUE_MAX + 1);
+    analog_filter_set_activity_threshold(&a.filter, (float)(ANALOG_FILTER_DEFAULT_ACTIVITY_THRESHOLD * AXIS_VALUE_SCALE));
+
+#if ANALOG_FILTER_NOISE_ADAPTATION
+    analog_filter_enable_noise_adaptation(&a.filter,
+                                          (float)(ANALOG_FILTER_MIN_ACTIVITY_THRESHOLD * AXIS_VALUE_SCALE),
+                                          (float)(ANALOG_FILTER_MAX_ACTIVITY_THRESHOLD * AXIS_VALUE_SCALE));
+#endif
+
+    // Just the responsive filter to start with. Other stages can be added to the pipeline.
+    filter_pipeline_init(&a.pipeline);
+    filter_pipeline_add_responsive(&a.pipeline, a.filter);
 
-    debug("created a new axis on ADC channel %u", adc_channel);
+    debug("created a new axis on ADC channel %u (%ux oversampled)", adc_channel, oversample);
 
     return a;
 }
@@ -143,8 +298,12 @@ joystick create_2axis_joystick(uint8_t x_adc_channel, uint8_t y_adc_channel) {
     joystick j;
     axis x, y;
 
-    x = create_axis(x_adc_channel);
-    y = create_axis(y_adc_channel);
+    x = create_axis(x_adc_channel, ADC_DEFAULT_OVERSAMPLE);
+    y = create_axis(y_adc_channel, ADC_DEFAULT_OVERSAMPLE);
+
+    // Sticks spring back to the middle
+    x.centered = true;
+    y.centered = true;
 
     j.x = x;
     j.y = y;
@@ -159,9 +318,14 @@ joystick create_3axis_joystick(uint8_t x_adc_channel, uint8_t y_adc_channel, uin
     joystick j;
     axis x, y, z;
 
-    x = create_axis(x_adc_channel);
-    y = create_axis(y_adc_channel);
-    z = create_axis(z_adc_channel);
+    x = create_axis(x_adc_channel, ADC_DEFAULT_OVERSAMPLE);
+    y = create_axis(y_adc_channel, ADC_DEFAULT_OVERSAMPLE);
+    z = create_axis(z_adc_channel, ADC_DEFAULT_OVERSAMPLE);
+
+    // Sticks spring back to the middle
+    x.centered = true;
+    y.centered = true;
+    z.centered = true;
 
     j.x = x;
     j.y = y;
@@ -177,7 +341,7 @@ pot create_pot(uint8_t adc_channel) {
     pot p;
     axis z;
 
-    z = create_axis(adc_channel);
+    z = create_axis(adc_channel, ADC_DEFAULT_OVERSAMPLE);
     p.z = z;
     debug("created a new pot");
     return p;
@@ -209,14 +373,15 @@ TaskHandle_t start_analog_reader_task()
 {
     TaskHandle_t reader_handle;
 
-    xTaskCreate(analog_reader_task,
-                "analog_reader_task",
-                configMINIMAL_STACK_SIZE + 512,
-                (void*)0,
-                1,
-                &reader_handle);
+    xTaskCreateAffinitySet(analog_reader_task,
+                           "analog_reader_task",
+                           configMINIMAL_STACK_SIZE + 512,
+                           (void*)0,
+                           ANALOG_READER_TASK_PRIORITY,
+                           TASK_CORE_MASK(ANALOG_READER_TASK_CORE),
+                           &reader_handle);
 
-#ifdef SUSPEND_READER_WHEN_NO_USB
+#if SUSPEND_READER_WHEN_NO_USB
     // Start off suspended! Will be started when the device is
     // mounted on the host
     vTaskSuspend(reader_handle);
@@ -229,14 +394,17 @@ TaskHandle_t start_button_reader_task()
 {
     TaskHandle_t reader_handle;
 
-    xTaskCreate(button_reader_task,
-                "button_reader_task",
-                configMINIMAL_STACK_SIZE + 512,
-                (void*)0,
-                1,
-                &reader_handle);
+    xTaskCreateAffinitySet(button_reader_task,
+                           "button_reader_task",
+                           configMINIMAL_STACK_SIZE + 512,
+                           (void*)0,
+                           BUTTON_READER_TASK_PRIORITY,
+                           TASK_CORE_MASK(BUTTON_READER_TASK_CORE),
+                           &reader_handle);
+
+    button_reader_task_handle = reader_handle;
 
-#ifdef SUSPEND_READER_WHEN_NO_USB
+#if SUSPEND_READER_WHEN_NO_USB
     // Start off suspended! Will be started when the device is
     // mounted on the host
     vTaskSuspend(reader_handle);
@@ -250,19 +418,70 @@ portTASK_FUNCTION(analog_reader_task, pvParameters) {
 
     joystick_adc_init();
 
+    // Describe everything we want to read to the scan engine once, up front
+    adc_scan_init(xTaskGetCurrentTaskHandle());
+    for(int i = 0; i < number_of_axen; i++) {
+        axis* a = axis_collection[i];
+        a->scan_slot = adc_scan_add_burst(a->adc_channel, a->oversample);
+    }
+    adc_scan_build();
+
+    // From here on the hardware timer sets the pace for both readers
+    sample_clock_start(button_reader_task_handle);
+
+    controller_state state;
+    memset(&state, '\0', sizeof(controller_state));
+
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "EndlessLoop"
 
     for(EVER) {
 
+        // Sleep until the scan engine says the whole frame is in
+        if(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ADC_SCAN_TIMEOUT_MS)) == 0) {
+            warning("timed out waiting on an ADC frame");
+            continue;
+        }
+
+        const adc_scan_frame *frame = adc_scan_latest_frame();
+
+        // Run every axis's pipeline up to its responsive filter...
         for(int i = 0; i < number_of_axen; i++) {
 
             axis* a = axis_collection[i];
-            read_value(a);
-            verbose("read value %d (%d) from adc_channel %d", a->filtered_value, a->raw_value,  a->adc_channel);
+
+            uint32_t sum = 0;
+            for(uint8_t j = 0; j < a->oversample; j++) {
+                sum += frame->values[a->scan_slot + j];
+            }
+
+            filter_pipeline_stage_input(&a->pipeline, condition_reading(a, decimate_samples(sum, a->oversample)));
+        }
+
+        // ...run all of the responsive filters in one go...
+        analog_filter_bank_update(&analog_filter_default_bank);
+
+        // ...finish off the pipelines...
+        state.flags = 0;
+        for(int i = 0; i < number_of_axen; i++) {
+            axis* a = axis_collection[i];
+            publish_filtered_value(a, filter_pipeline_finish(&a->pipeline));
+            state.axes[i] = a->filtered_value;
+
+            if(analog_filter_is_sleeping(&a->filter)) {
+                state.flags |= CONTROLLER_STATE_FILTER_SLEEPING;
+            }
+            if(a->raw_value <= a->calibration.min || a->raw_value >= a->calibration.max) {
+                state.flags |= CONTROLLER_STATE_CLIPPED;
+            }
         }
 
-        vTaskDelay(pdMS_TO_TICKS(POLLING_INTERVAL));
+        // ...and let everyone see the whole frame at once
+        state.frame_number = frame->frame_number;
+        state.timestamp_us = frame->timestamp_us;
+        state.number_of_axes = number_of_axen;
+        state.buttons = button_state_mask;
+        controller_state_publish(&state);
 
     }
 
@@ -276,21 +495,30 @@ portTASK_FUNCTION(button_reader_task, pvParameters) {
 
     info("starting the button reader task");
 
+    // The scanner takes over the MUX and button input pins. It's set up from here so its IRQ
+    // is on the same core as this task.
+    button_scan_init(xTaskGetCurrentTaskHandle());
+
+    uint64_t changed_at_us[MAX_NUMBER_OF_BUTTONS];
+
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "EndlessLoop"
 
     for(EVER) {
 
-        // Walk all of the buttons and update the button state var
-        for(uint8_t i = 0; i < MAX_NUMBER_OF_BUTTONS; i++) {
+        // Wait for the sample clock, or for the scanner to see something change
+        uint32_t reasons = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &reasons, portMAX_DELAY);
+        bool sweep = (reasons & SAMPLE_CLOCK_BUTTON_SWEEP) != 0;
 
-            // Set the MUX mask for this button
-            gpio_put_masked(BUTTON_GPIO_MASK, BUTTON_MUX_MASKS[i]);
+        // The scanner's already walked the MUX, just pick up where it's at
+        button_t pressed = button_scan_read(changed_at_us);
+        uint64_t now = time_us_64();
 
-            // This might not be needed. The MUX's datasheet says it needs 200ns.
-            sleep_us(1);
+        // Debounce all of the buttons and update the button state var
+        for(uint8_t i = 0; i < MAX_NUMBER_OF_BUTTONS; i++) {
 
-            if(!gpio_get(BUTTON_IN)) {
+            if(button_debounce_update(i, pressed & (1u << i), changed_at_us[i], now, sweep)) {
                 setButton(&button_state_mask, i);
             }
             else {
@@ -298,9 +526,6 @@ portTASK_FUNCTION(button_reader_task, pvParameters) {
             }
         }
 
-
-        vTaskDelay(pdMS_TO_TICKS(POLLING_INTERVAL));
-
     }
 
 #pragma clang diagnostic pop
@@ -16,19 +16,48 @@ extern "C"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 
+#include "joystick/filter_pipeline.h"
+#include "joystick/response_curve.h"
 #include "joystick/responsive_analog_read_filter.h"
 
 // Reader task for this joystick
 portTASK_FUNCTION_PROTO(analog_reader_task, pvParameters);
 portTASK_FUNCTION_PROTO(button_reader_task, pvParameters);
 
+// Axis values are 16 bits all the way through the filter, no matter how many bits the ADC has
+#define AXIS_VALUE_BITS         16
+#define AXIS_VALUE_MAX          ((1 << AXIS_VALUE_BITS) - 1)
+#define AXIS_VALUE_CENTER       (1 << (AXIS_VALUE_BITS - 1))
+
+// What goes out in the HID report is the top HID_AXIS_BITS of that
+#if HID_AXIS_BITS != 8 && HID_AXIS_BITS != 12 && HID_AXIS_BITS != 16
+#error "HID_AXIS_BITS has to be 8, 12, or 16"
+#endif
+#define HID_AXIS_MAX            ((1 << HID_AXIS_BITS) - 1)
+#define HID_AXIS_CENTER         (1 << (HID_AXIS_BITS - 1))
+
+typedef struct {
+    uint16_t min;               // In AXIS_VALUE_BITS, not ADC counts
+    uint16_t center;
+    uint16_t max;
+    uint32_t scale_low;         // Q16, stretches min..center over the bottom half
+    uint32_t scale_high;        // Q16, and center..max over the top half
+} axis_calibration;
+
 typedef struct {
     uint8_t adc_channel;
-    uint16_t raw_value;
-    uint8_t filtered_value;
-    uint16_t adc_min;
-    uint16_t adc_max;
-    analog_filter filter;
+    uint8_t index;              // Where it is in axis_collection and the controller state
+    uint8_t oversample;         // Conversions per frame
+    uint8_t scan_slot;          // First of them in the scan frame
+    uint16_t raw_value;         // Averaged and scaled up to AXIS_VALUE_BITS
+    uint16_t filtered_value;    // In HID_AXIS_BITS, unsigned
+    axis_calibration calibration;           // What the reader's using. Only the reader changes it.
+    axis_calibration staged_calibration;    // A new one waiting for the reader to pick it up
+    volatile bool calibration_staged;
+    bool centered;              // Springs back to the middle, so the center is worth calibrating
+    analog_filter filter;       // This axis's slot in the filter bank
+    filter_pipeline pipeline;   // What the reading goes through, which usually includes the filter
+    const uint16_t *response_curve;     // Compiled curve for the output, NULL for a straight line
     bool inverted;
 } axis;
 
@@ -46,7 +75,12 @@ void init_reader();
 void register_axis(axis* a);
 
 void update_axis(axis *axis, uint16_t new_value);
+uint16_t decimate_samples(uint32_t sum, uint8_t conversions);
 void read_value(axis* a);
+axis create_axis(uint8_t adc_channel, uint8_t oversample);
+bool axis_set_response_curve(axis* a, const response_curve* curve);
+bool axis_set_calibration(axis* a, uint16_t min, uint16_t center, uint16_t max);
+axis_calibration axis_get_calibration(axis* a);
 joystick create_2axis_joystick(uint8_t x_adc_channel, uint8_t y_adc_channel);
 joystick create_3axis_joystick(uint8_t x_adc_channel, uint8_t y_adc_channel, uint8_t z_adc_channel);
 pot create_pot(uint8_t adc_channel);
@@ -0,0 +1,193 @@
+
+#include <math.h>
+#include <string.h>
+
+#include "controller-config.h"
+
+#include "joystick/response_curve.h"
+
+#include "logging/logging.h"
+
+#define CURVE_MAX       65535.0f
+#define CURVE_MIDDLE    (CURVE_MAX / 2.0f)
+
+typedef struct {
+    bool in_use;
+    response_curve curve;
+    uint16_t table[RESPONSE_CURVE_TABLE_SIZE];
+} response_curve_slot;
+
+static response_curve_slot pool[RESPONSE_CURVE_MAX_TABLES];
+
+
+static bool is_straight_line(const response_curve *curve) {
+    return curve->center_deadzone == 0 && curve->low_deadzone == 0 && curve->high_deadzone == 0 &&
+           curve->expo == 0 && curve->number_of_points < 2;
+}
+
+static bool is_valid(const response_curve *curve) {
+
+    if(curve->center_deadzone >= (uint16_t)CURVE_MIDDLE) {
+        warning("a center deadzone of %u takes up the whole axis", curve->center_deadzone);
+        return false;
+    }
+
+    if((uint32_t)curve->low_deadzone + curve->high_deadzone >= (uint32_t)CURVE_MAX) {
+        warning("edge deadzones of %u and %u take up the whole axis", curve->low_deadzone, curve->high_deadzone);
+        return false;
+    }
+
+    if(curve->expo > 100) {
+        warning("expo can't be more than 100%% (was %u%%)", curve->expo);
+        return false;
+    }
+
+    if(curve->number_of_points > RESPONSE_CURVE_MAX_POINTS) {
+        warning("a response curve can't have more than %d points", RESPONSE_CURVE_MAX_POINTS);
+        return false;
+    }
+
+    for(uint8_t i = 1; i < curve->number_of_points; i++) {
+        if(curve->points[i].x <= curve->points[i - 1].x) {
+            warning("response curve points need to be in order of x (point %u is out of order)", i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static float follow_points(const response_curve *curve, float x) {
+
+    const response_curve_point *p = curve->points;
+    uint8_t last = curve->number_of_points - 1;
+
+    if(x <= p[0].x) {
+        return p[0].y;
+    }
+    if(x >= p[last].x) {
+        return p[last].y;
+    }
+
+    uint8_t i = 1;
+    while(x > p[i].x) {
+        i++;
+    }
+
+    float t = (x - p[i - 1].x) / (float)(p[i].x - p[i - 1].x);
+    return p[i - 1].y + t * ((float)p[i].y - (float)p[i - 1].y);
+}
+
+/**
+ * Where one input lands on the curve. This is the slow way, it only runs when building a table.
+ */
+static float evaluate(const response_curve *curve, float x) {
+
+    // Edge deadzones, and stretch what's left back out
+    float low = curve->low_deadzone;
+    float high = CURVE_MAX - curve->high_deadzone;
+    x = (x - low) * CURVE_MAX / (high - low);
+    x = fminf(fmaxf(x, 0.0f), CURVE_MAX);
+
+    // Center deadzone and expo work on the distance from the middle
+    float u = (x - CURVE_MIDDLE) / CURVE_MIDDLE;
+    float distance = fabsf(u);
+    float deadzone = curve->center_deadzone / CURVE_MIDDLE;
+
+    distance = distance <= deadzone ? 0.0f : (distance - deadzone) / (1.0f - deadzone);
+
+    float expo = curve->expo / 100.0f;
+    distance = (1.0f - expo) * distance + expo * distance * distance * distance;
+
+    x = CURVE_MIDDLE + (u < 0.0f ? -distance : distance) * CURVE_MIDDLE;
+
+    if(curve->number_of_points >= 2) {
+        x = follow_points(curve, x);
+    }
+
+    return fminf(fmaxf(x, 0.0f), CURVE_MAX);
+}
+
+static void build_table(const response_curve *curve, uint16_t *table) {
+
+    // Spread the entries so the first and last land right on the ends of the axis
+    for(uint32_t i = 0; i < RESPONSE_CURVE_TABLE_SIZE; i++) {
+        float x = (float)i * CURVE_MAX / (RESPONSE_CURVE_TABLE_SIZE - 1);
+        table[i] = (uint16_t)(evaluate(curve, x) + 0.5f);
+    }
+}
+
+/**
+ * @brief Turns a curve into a lookup table
+ *
+ * If another axis already has the same curve, its table gets shared.
+ *
+ * @param curve the curve to build
+ * @param table where to put the table for response_curve_apply(). NULL is a straight line,
+ *        which is also what a curve gets if it can't be built.
+ * @return false if the curve isn't valid or there's no room for it
+ */
+bool response_curve_compile(const response_curve *curve, const uint16_t **table) {
+
+    *table = NULL;
+
+    if(!is_valid(curve)) {
+        return false;
+    }
+
+    // Copy it over something clean so unused points don't stop two curves from matching
+    response_curve wanted;
+    memset(&wanted, '\0', sizeof(response_curve));
+    wanted.center_deadzone = curve->center_deadzone;
+    wanted.low_deadzone = curve->low_deadzone;
+    wanted.high_deadzone = curve->high_deadzone;
+    wanted.expo = curve->expo;
+    wanted.number_of_points = curve->number_of_points;
+    memcpy(wanted.points, curve->points, sizeof(response_curve_point) * curve->number_of_points);
+
+    if(is_straight_line(&wanted)) {
+        return true;
+    }
+
+    response_curve_slot *free_slot = NULL;
+
+    for(uint8_t i = 0; i < RESPONSE_CURVE_MAX_TABLES; i++) {
+        if(!pool[i].in_use) {
+            if(free_slot == NULL) {
+                free_slot = &pool[i];
+            }
+        }
+        else if(memcmp(&pool[i].curve, &wanted, sizeof(response_curve)) == 0) {
+            debug("sharing response curve table %u", i);
+            *table = pool[i].table;
+            return true;
+        }
+    }
+
+    if(free_slot == NULL) {
+        error("out of response curve tables (there's %d), using a straight line", RESPONSE_CURVE_MAX_TABLES);
+        return false;
+    }
+
+    free_slot->curve = wanted;
+    build_table(&wanted, free_slot->table);
+    free_slot->in_use = true;
+
+    info("built response curve table %u: center deadzone %u, edges %u/%u, expo %u%%, %u points",
+         (uint8_t)(free_slot - pool), wanted.center_deadzone, wanted.low_deadzone, wanted.high_deadzone,
+         wanted.expo, wanted.number_of_points);
+
+    *table = free_slot->table;
+    return true;
+}
+
+uint8_t response_curve_tables_in_use() {
+
+    uint8_t count = 0;
+    for(uint8_t i = 0; i < RESPONSE_CURVE_MAX_TABLES; i++) {
+        if(pool[i].in_use) {
+            count++;
+        }
+    }
+    return count;
+}
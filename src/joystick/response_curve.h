@@ -0,0 +1,66 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "controller-config.h"
+
+/**
+ * Response curves for the axes
+ *
+ * A curve is a center deadzone, deadzones at each end, expo, and optionally a list of points
+ * to go through, all applied to what comes out of the filter. Working all of that out on
+ * every sample is too much for the M0+, so a curve gets compiled into a lookup table once
+ * when it's set, and after that applying it is one load.
+ *
+ * The tables are big (RESPONSE_CURVE_TABLE_SIZE 16 bit entries each), so they come from a
+ * pool of RESPONSE_CURVE_MAX_TABLES and axes with the same curve share one. A curve that
+ * doesn't do anything doesn't need a table at all. Tables never go back in the pool, curves are
+ * meant to be set once when the config loads.
+ *
+ * Everything's in 16 bit axis counts. The steps happen in this order:
+ *
+ *   1. Edge deadzones: the first low_deadzone and last high_deadzone counts are pinned to
+ *      the ends, and what's left is stretched back out to full scale
+ *   2. Center deadzone: anything within center_deadzone of the middle is the middle
+ *   3. Expo, from 0 (straight) to 100 (all cubic), which softens the middle
+ *   4. The points, if there's at least two of them. In between them is a straight line, and
+ *      past the first or last one is flat.
+ */
+
+#define RESPONSE_CURVE_TABLE_SIZE   (1 << RESPONSE_CURVE_TABLE_BITS)
+#define RESPONSE_CURVE_INDEX_SHIFT  (16 - RESPONSE_CURVE_TABLE_BITS)
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+} response_curve_point;
+
+typedef struct {
+    uint16_t center_deadzone;       // Each side of the middle
+    uint16_t low_deadzone;
+    uint16_t high_deadzone;
+    uint8_t expo;                   // Percent
+    uint8_t number_of_points;
+    response_curve_point points[RESPONSE_CURVE_MAX_POINTS];     // In order of x
+} response_curve;
+
+bool response_curve_compile(const response_curve *curve, const uint16_t **table);
+uint8_t response_curve_tables_in_use();
+
+/**
+ * Run a value through a compiled curve. A NULL table is a straight line.
+ */
+static inline uint16_t response_curve_apply(const uint16_t *table, uint16_t value) {
+    return table == NULL ? value : table[value >> RESPONSE_CURVE_INDEX_SHIFT];
+}
+
+#ifdef __cplusplus
+}
+#endif
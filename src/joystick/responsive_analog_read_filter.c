@@ -33,61 +33,122 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+
+#include "pico/platform.h"
+
 #include "logging/logging.h"
 
 #include "responsive_analog_read_filter.h"
+#include "snap_curve_table.h"
 
-analog_filter create_analog_filter(bool sleep_enable, float snap_multiplier) {
 
-    analog_filter f = {};
+analog_filter_bank analog_filter_default_bank;
+
+
+static void set_error_ema_gain(analog_filter_bank *bank, uint8_t i, float gain) {
+#if ANALOG_FILTER_FIXED_POINT
+    bank->error_ema_gain[i] = (analog_filter_gain)(gain * ANALOG_FILTER_GAIN_ONE + 0.5f);
+#else
+    bank->error_ema_gain[i] = gain;
+#endif
+}
+
+void analog_filter_bank_init(analog_filter_bank *bank) {
+    memset(bank, '\0', sizeof(analog_filter_bank));
+}
+
+/**
+ * Set up the next free slot in a bank with the defaults from the CPP constructor
+ */
+analog_filter analog_filter_bank_add(analog_filter_bank *bank, bool sleep_enable, float snap_multiplier) {
+
+    if(bank->count >= ANALOG_FILTER_BANK_SIZE) {
+        fatal("more than %d analog filters in one bank", ANALOG_FILTER_BANK_SIZE);
+
+        // Share the last slot rather than run off the end
+        return (analog_filter){ .bank = bank, .slot = ANALOG_FILTER_BANK_SIZE - 1 };
+    }
+
+    analog_filter f = {
+            .bank = bank,
+            .slot = bank->count++
+    };
 
-    // Grab the defaults from the CPP constructor
-    f.sleep_enable = sleep_enable;
-    f.snap_multiplier = snap_multiplier;
-    f.analog_resolution = 4096;
-    f.activity_threshold = (float)25.0;
-    f.edge_snap_enable = true;
-    f.error_ema = (float)0.0;
-    f.sleeping = false;
+    uint8_t i = f.slot;
+    bank->sleep_enable[i] = sleep_enable;
+    bank->analog_resolution[i] = 4096;
+    bank->edge_snap_enable[i] = true;
+    bank->error_ema[i] = 0;
+    bank->smooth_value[i] = 0;
+    bank->sleeping[i] = false;
 
-    f.raw_value = 0;
-    f.responsive_value = 0;
-    f.previous_responsive_value = 0;
-    f.responsive_value_has_changed = false;
+    // These might need converting to fixed point
+    analog_filter_set_snap_multiplier(&f, snap_multiplier);
+    analog_filter_set_activity_threshold(&f, (float)ANALOG_FILTER_DEFAULT_ACTIVITY_THRESHOLD);
+    set_error_ema_gain(bank, i, ANALOG_FILTER_DEFAULT_ERROR_EMA_GAIN);
 
-    debug("new analog_filter created");
+    bank->noise_adaptation_enable[i] = false;
+    bank->noise_count[i] = 0;
+    bank->noise_floor[i] = 0;
+
+    bank->raw_value[i] = 0;
+    bank->responsive_value[i] = 0;
+    bank->responsive_value_has_changed[i] = false;
+
+    debug("new analog_filter created in slot %u", i);
 
     return f;
+}
 
+analog_filter create_analog_filter(bool sleep_enable, float snap_multiplier) {
+    return analog_filter_bank_add(&analog_filter_default_bank, sleep_enable, snap_multiplier);
 }
 
 uint16_t analog_filter_get_raw_value(analog_filter* filter) {
-    return filter->raw_value;
+    return filter->bank->raw_value[filter->slot];
 }
 
 uint16_t analog_filter_get_value(analog_filter* filter) {
-    return filter->responsive_value;
+    return filter->bank->responsive_value[filter->slot];
 }
 
 bool analog_filter_has_changed(analog_filter* filter) {
-    return filter->responsive_value_has_changed;
+    return filter->bank->responsive_value_has_changed[filter->slot];
 }
 
 bool analog_filter_is_sleeping(analog_filter* filter) {
-    return filter->sleeping;
+    return filter->bank->sleeping[filter->slot];
+}
+
+/**
+ * Stage a new reading for the next analog_filter_bank_update()
+ */
+void analog_filter_set_input(analog_filter* filter, uint16_t raw_value) {
+    filter->bank->raw_value[filter->slot] = raw_value;
 }
 
+/**
+ * Update just this one filter right now
+ */
 void analog_filter_update(analog_filter* filter, uint16_t raw_value) {
 
-    filter->raw_value = raw_value;
-    filter->previous_responsive_value = filter->responsive_value;
-    filter->responsive_value = analog_filter_get_responsive_value(filter, raw_value);
-    filter->responsive_value_has_changed = filter->responsive_value != filter->previous_responsive_value;
+    analog_filter_bank *bank = filter->bank;
+    uint8_t i = filter->slot;
+
+    uint16_t previous = bank->responsive_value[i];
+
+    bank->raw_value[i] = raw_value;
+    bank->responsive_value[i] = analog_filter_get_responsive_value(filter, raw_value);
+    bank->responsive_value_has_changed[i] = bank->responsive_value[i] != previous;
 
 }
 
 void analog_filter_set_snap_multiplier(analog_filter* filter, float new_multiplier) {
 
+    analog_filter_bank *bank = filter->bank;
+    uint8_t i = filter->slot;
+
     if(new_multiplier > 1.0) {
         new_multiplier = (float)1.0;
     }
@@ -95,35 +156,228 @@ void analog_filter_set_snap_multiplier(analog_filter* filter, float new_multipli
         new_multiplier = (float)0.0;
     }
 
-    filter->snap_multiplier = new_multiplier;
+#if ANALOG_FILTER_FIXED_POINT
+    bank->snap_multiplier[i] = (analog_filter_gain)(new_multiplier * (1 << ANALOG_FILTER_SNAP_SHIFT) + 0.5f);
+
+    // diff * snap_multiplier >= 1 is the flat part of the curve, so there's no need to multiply
+    bank->snap_saturation_diff[i] = bank->snap_multiplier[i] > 0
+            ? ((1u << ANALOG_FILTER_SNAP_SHIFT) + bank->snap_multiplier[i] - 1) / bank->snap_multiplier[i]
+            : UINT32_MAX;
+#else
+    bank->snap_multiplier[i] = new_multiplier;
+#endif
 }
 
 
 void analog_filter_enable_sleep(analog_filter* filter) {
-    filter->sleep_enable = true;
+    filter->bank->sleep_enable[filter->slot] = true;
 }
 
 void analog_filter_disable_sleep(analog_filter* filter) {
-    filter->sleep_enable = false;
+    filter->bank->sleep_enable[filter->slot] = false;
 }
 
 void analog_filter_enable_edge_snap(analog_filter* filter) {
-    filter->edge_snap_enable = true;
+    filter->bank->edge_snap_enable[filter->slot] = true;
 }
 
 void analog_filter_disable_edge_snap(analog_filter* filter) {
-    filter->edge_snap_enable = false;
+    filter->bank->edge_snap_enable[filter->slot] = false;
 }
 
 void analog_filter_set_activity_threshold(analog_filter* filter, float new_threshold) {
-    filter->activity_threshold = new_threshold;
+#if ANALOG_FILTER_FIXED_POINT
+    filter->bank->activity_threshold[filter->slot] = (analog_filter_value)(new_threshold * (1 << ANALOG_FILTER_VALUE_SHIFT) + 0.5f);
+#else
+    filter->bank->activity_threshold[filter->slot] = new_threshold;
+#endif
 }
 
-void analog_filter_set_analog_resolution(analog_filter* filter, uint16_t resolution) {
-    filter->analog_resolution = resolution;
+void analog_filter_set_analog_resolution(analog_filter* filter, uint32_t resolution) {
+    filter->bank->analog_resolution[filter->slot] = resolution;
 }
 
-uint16_t analog_filter_get_responsive_value(analog_filter* filter, uint16_t new_value) {
+float analog_filter_get_activity_threshold(analog_filter* filter) {
+#if ANALOG_FILTER_FIXED_POINT
+    return (float)filter->bank->activity_threshold[filter->slot] / (1 << ANALOG_FILTER_VALUE_SHIFT);
+#else
+    return filter->bank->activity_threshold[filter->slot];
+#endif
+}
+
+
+/*
+ * Noise adaptation
+ *
+ * Every axis has its own noise floor, so one activity threshold for all of them means some
+ * chatter and some feel sticky. With adaptation turned on, the filter keeps a running variance
+ * of the raw input (Welford's method) while it's asleep, which is when the axis is sitting
+ * still and all that's left is noise. Every ANALOG_FILTER_NOISE_WINDOW samples that gets
+ * folded into the noise floor, and the activity threshold is set to ANALOG_FILTER_NOISE_SIGMAS
+ * times that, kept between the bounds given here.
+ *
+ * If the top bound holds the threshold down close enough to the noise that the error EMA would
+ * keep waking the filter up, the EMA's gain comes down so it averages more of the noise away,
+ * as far as ANALOG_FILTER_MIN_ERROR_EMA_GAIN.
+ *
+ * Waking up throws away whatever's been gathered since the last fold, since it might have the
+ * start of a movement in it. It needs sleep enabled to do anything.
+ */
+
+#define NOISE_SHIFT             12
+#define NOISE_GAIN_ONE          (1 << 16)
+#define NOISE_MAX_GAIN          ((uint32_t)(ANALOG_FILTER_DEFAULT_ERROR_EMA_GAIN * NOISE_GAIN_ONE))
+#define NOISE_MIN_GAIN          ((uint32_t)(ANALOG_FILTER_MIN_ERROR_EMA_GAIN * NOISE_GAIN_ONE))
+
+/**
+ * @param min_threshold the lowest the activity threshold can go, in counts
+ * @param max_threshold the highest it can go
+ */
+void analog_filter_enable_noise_adaptation(analog_filter* filter, float min_threshold, float max_threshold) {
+
+    analog_filter_bank *bank = filter->bank;
+    uint8_t i = filter->slot;
+
+    if(min_threshold < 0.0f) {
+        min_threshold = 0.0f;
+    }
+    if(max_threshold < min_threshold) {
+        max_threshold = min_threshold;
+    }
+
+    bank->noise_threshold_min[i] = (uint32_t)(min_threshold + 0.5f);
+    bank->noise_threshold_max[i] = (uint32_t)(max_threshold + 0.5f);
+    bank->noise_count[i] = 0;
+    bank->noise_adaptation_enable[i] = true;
+}
+
+/**
+ * Stop adapting. The threshold stays where it ended up, and the error EMA goes back to normal.
+ */
+void analog_filter_disable_noise_adaptation(analog_filter* filter) {
+    filter->bank->noise_adaptation_enable[filter->slot] = false;
+    set_error_ema_gain(filter->bank, filter->slot, ANALOG_FILTER_DEFAULT_ERROR_EMA_GAIN);
+}
+
+/**
+ * The standard deviation of the input while the axis is still, in counts. 0 until there's
+ * been a full window of it.
+ */
+float analog_filter_get_noise_floor(analog_filter* filter) {
+    return (float)filter->bank->noise_floor[filter->slot] / (1 << NOISE_SHIFT);
+}
+
+// These two only run once a window, but they're called from analog_filter_track_noise(), so
+// they're in RAM with it
+
+static uint32_t __not_in_flash_func(square_root)(uint64_t value) {
+
+    uint64_t result = 0;
+    uint64_t bit = 1ull << 62;
+
+    while(bit > value) {
+        bit >>= 2;
+    }
+
+    while(bit != 0) {
+        if(value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)result;
+}
+
+/**
+ * A window's done, fold it into the noise floor and retune the filter to match
+ */
+static void __not_in_flash_func(adapt_to_noise)(analog_filter_bank *bank, uint8_t i) {
+
+    uint32_t sigma = square_root(bank->noise_m2[i] / (bank->noise_count[i] - 1));
+
+    if(bank->noise_floor[i] == 0) {
+        bank->noise_floor[i] = sigma;
+    }
+    else {
+        bank->noise_floor[i] = (uint32_t)((int32_t)bank->noise_floor[i] + ((int32_t)sigma - (int32_t)bank->noise_floor[i]) / 4);
+    }
+
+    uint64_t noise = bank->noise_floor[i];
+    uint64_t threshold = noise * ANALOG_FILTER_NOISE_SIGMAS;
+    uint64_t min = (uint64_t)bank->noise_threshold_min[i] << NOISE_SHIFT;
+    uint64_t max = (uint64_t)bank->noise_threshold_max[i] << NOISE_SHIFT;
+
+    if(threshold < min) {
+        threshold = min;
+    }
+    else if(threshold > max) {
+        threshold = max;
+    }
+
+    // An EMA with gain a has a standard deviation of sigma * sqrt(a / (2 - a)). Pick the gain
+    // that puts the threshold ANALOG_FILTER_NOISE_SIGMAS of those out: 2T^2 / (S^2 sigma^2 + T^2)
+    uint64_t t2 = threshold * threshold;
+    uint64_t s2 = noise * noise * ANALOG_FILTER_NOISE_SIGMAS * ANALOG_FILTER_NOISE_SIGMAS;
+    uint32_t gain = NOISE_MAX_GAIN;
+
+    if(s2 + t2 > 0) {
+        uint64_t fitted = ((t2 >> 8) * 2 * NOISE_GAIN_ONE) / ((s2 + t2) >> 8 | 1);
+        if(fitted < gain) {
+            gain = fitted < NOISE_MIN_GAIN ? NOISE_MIN_GAIN : (uint32_t)fitted;
+        }
+    }
+
+#if ANALOG_FILTER_FIXED_POINT
+    // Same Q20.12 and Q16 that the filter uses, nothing to convert
+    bank->activity_threshold[i] = (analog_filter_value)threshold;
+    bank->error_ema_gain[i] = (analog_filter_gain)gain;
+#else
+    bank->activity_threshold[i] = (float)threshold / (1 << NOISE_SHIFT);
+    bank->error_ema_gain[i] = (float)gain / NOISE_GAIN_ONE;
+#endif
+}
+
+void __not_in_flash_func(analog_filter_track_noise)(analog_filter_bank *bank, uint8_t i, uint16_t raw_value) {
+
+    if(!bank->noise_adaptation_enable[i]) {
+        return;
+    }
+
+    if(!bank->sleeping[i]) {
+        bank->noise_count[i] = 0;
+        return;
+    }
+
+    int32_t x = (int32_t)raw_value << NOISE_SHIFT;
+    uint16_t n = ++bank->noise_count[i];
+
+    if(n == 1) {
+        bank->noise_mean[i] = x;
+        bank->noise_m2[i] = 0;
+        return;
+    }
+
+    // Both deltas always have the same sign, so M2 only ever goes up
+    int32_t delta = x - bank->noise_mean[i];
+    bank->noise_mean[i] += delta / n;
+    bank->noise_m2[i] += (uint64_t)((int64_t)delta * (x - bank->noise_mean[i]));
+
+    if(n >= ANALOG_FILTER_NOISE_WINDOW) {
+        adapt_to_noise(bank, i);
+        bank->noise_count[i] = 0;
+    }
+}
+
+#if !ANALOG_FILTER_FIXED_POINT
+
+// The fixed point version of these is in responsive_analog_read_filter_fixed.c
+
+static __force_inline uint16_t responsive_value(analog_filter_bank *bank, uint8_t i, uint16_t new_value) {
 
     // If sleep and edge snap are enabled and the new value is very close to an edge, drag it
     // a little closer to the edges.
@@ -131,36 +385,48 @@ uint16_t analog_filter_get_responsive_value(analog_filter* filter, uint16_t new_
     // This will make it easier to pull the output values right to the extremes without sleeping,
     // and it'll make movements right near the edge appear larger, making it easier to wake up
 
-    if(filter->sleep_enable && filter->edge_snap_enable) {
-        if(new_value < filter->activity_threshold) {
-            new_value = (new_value * 2) - filter->activity_threshold;
+    if(bank->sleep_enable[i] && bank->edge_snap_enable[i]) {
+
+        float snapped = new_value;
+        if(new_value < bank->activity_threshold[i]) {
+            snapped = (new_value * 2) - bank->activity_threshold[i];
+        }
+        else if(new_value > bank->analog_resolution[i] - bank->activity_threshold[i]) {
+            snapped = (new_value * 2) - bank->analog_resolution[i] + bank->activity_threshold[i];
+        }
+
+        // Dragging it toward the edge can push it past the edge, which doesn't fit in a uint16_t
+        if(snapped < 0.0f) {
+            snapped = 0.0f;
         }
-        else if(new_value > filter->analog_resolution - filter->activity_threshold) {
-            new_value = (new_value * 2) - filter->analog_resolution + filter->activity_threshold;
+        else if(snapped > bank->analog_resolution[i] - 1) {
+            snapped = bank->analog_resolution[i] - 1;
         }
+
+        new_value = (uint16_t)snapped;
     }
 
     // get difference between new input value and current smooth value
-    uint16_t diff = abs(new_value - filter->smooth_value);
+    uint16_t diff = abs(new_value - bank->smooth_value[i]);
 
     // measure the difference between the new value and current value
     // and use another exponential moving average to work out what
     // the current margin of error is
-    filter->error_ema += ((new_value - filter->smooth_value) - filter->error_ema) * 0.4;
+    bank->error_ema[i] += ((new_value - bank->smooth_value[i]) - bank->error_ema[i]) * bank->error_ema_gain[i];
 
     // if sleep has been enabled, sleep when the amount of error is below the activity threshold
-    if(filter->sleep_enable) {
+    if(bank->sleep_enable[i]) {
 
         // recalculate sleeping status
-        filter->sleeping = abs(filter->error_ema) < filter->activity_threshold;
+        bank->sleeping[i] = abs(bank->error_ema[i]) < bank->activity_threshold[i];
 
     }
 
     // if we're allowed to sleep, and we're sleeping
     // then don't update responsiveValue this loop
     // just output the existing responsiveValue
-    if(filter->sleep_enable && filter->sleeping) {
-        return (uint16_t)filter->smooth_value;
+    if(bank->sleep_enable[i] && bank->sleeping[i]) {
+        return (uint16_t)bank->smooth_value[i];
     }
 
     // use a 'snap curve' function, where we pass in the diff (x) and get back a number from 0-1.
@@ -173,36 +439,73 @@ uint16_t analog_filter_get_responsive_value(analog_filter* filter, uint16_t new_
     // Finally, the result is multiplied by 2 and capped at a maximum of one, which means that at a certain point all larger movements are maximally snappy
 
     // then multiply the input by SNAP_MULTIPLER so input values fit the snap curve better.
-    float snap = analog_filter_snap_curve(diff * filter->snap_multiplier);
+    // The table does the same thing as analog_filter_snap_curve() without the divide
+    float x = diff * bank->snap_multiplier[i];
+    float snap = x >= 1.0f ? 1.0f : (float)snap_curve_lookup((uint32_t)(x * SNAP_CURVE_ONE)) / SNAP_CURVE_ONE;
 
     // when sleep is enabled, the emphasis is stopping on a responsiveValue quickly, and it's less about easing into position.
     // If sleep is enabled, add a small amount to snap so it'll tend to snap into a more accurate position before sleeping starts.
-    if(filter->sleep_enable) {
-        snap *= 0.5 + 0.5;
+    if(bank->sleep_enable[i]) {
+        snap *= 0.5f + 0.5f;
     }
 
     // calculate the exponential moving average based on the snap
-    filter->smooth_value += (new_value - filter->smooth_value) * snap;
+    bank->smooth_value[i] += (new_value - bank->smooth_value[i]) * snap;
 
     // ensure output is in bounds
-    if(filter->smooth_value < 0.0) {
-        filter->smooth_value = 0.0;
+    if(bank->smooth_value[i] < 0.0f) {
+        bank->smooth_value[i] = 0.0f;
     }
-    else if(filter->smooth_value > filter->analog_resolution - 1) {
-        filter->smooth_value = filter->analog_resolution - 1;
+    else if(bank->smooth_value[i] > bank->analog_resolution[i] - 1) {
+        bank->smooth_value[i] = bank->analog_resolution[i] - 1;
     }
 
-    return (uint16_t)filter->smooth_value;
+    return (uint16_t)bank->smooth_value[i];
 }
 
+uint16_t analog_filter_get_responsive_value(analog_filter* filter, uint16_t new_value) {
+    uint16_t value = responsive_value(filter->bank, filter->slot, new_value);
+    analog_filter_track_noise(filter->bank, filter->slot, new_value);
+    return value;
+}
+
+static __force_inline void update_slot(analog_filter_bank *bank, uint8_t i) {
+    uint16_t value = responsive_value(bank, i, bank->raw_value[i]);
+    analog_filter_track_noise(bank, i, bank->raw_value[i]);
+    bank->responsive_value_has_changed[i] = value != bank->responsive_value[i];
+    bank->responsive_value[i] = value;
+}
+
+/**
+ * Run every filter in the bank on whatever was last staged with analog_filter_set_input()
+ *
+ * Four at a time and then whatever's left, same as the fixed point one. The float math itself
+ * goes through the SDK's float routines.
+ */
+void __not_in_flash_func(analog_filter_bank_update)(analog_filter_bank *bank) {
+
+    uint8_t i = 0;
+    for(; i + 4 <= bank->count; i += 4) {
+        update_slot(bank, i);
+        update_slot(bank, i + 1);
+        update_slot(bank, i + 2);
+        update_slot(bank, i + 3);
+    }
+    for(; i < bank->count; i++) {
+        update_slot(bank, i);
+    }
+}
+
+#endif
+
 
 float analog_filter_snap_curve(float x) {
 
-    float y = 1.0 / (x + 1.0);
-    y = (1.0 - y) * 2.0;
-    if(y > 1.0) {
-        return 1.0;
+    float y = 1.0f / (x + 1.0f);
+    y = (1.0f - y) * 2.0f;
+    if(y > 1.0f) {
+        return 1.0f;
     }
 
     return y;
-}
\ No newline at end of file
+}
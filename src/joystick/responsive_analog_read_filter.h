@@ -41,33 +41,101 @@ extern "C"
 #endif
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdbool.h>
 
+#include "controller-config.h"
 
+/*
+ * With ANALOG_FILTER_FIXED_POINT set the filter does all of its per-update math in integers,
+ * since the M0+ doesn't have an FPU. Values are Q20.12, the snap multiplier is Q24, and the
+ * snap curve is Q16. The API is the same either way, the floats passed to the setters are
+ * converted once when they're set.
+ */
+#if ANALOG_FILTER_FIXED_POINT
+typedef int32_t analog_filter_value;
+typedef int32_t analog_filter_gain;
+
+#define ANALOG_FILTER_VALUE_SHIFT   12
+#define ANALOG_FILTER_SNAP_SHIFT    24
+#define ANALOG_FILTER_GAIN_ONE      (1 << 16)
+#else
+typedef float analog_filter_value;
+typedef float analog_filter_gain;
+#endif
+
+#define ANALOG_FILTER_DEFAULT_ACTIVITY_THRESHOLD    25
+#define ANALOG_FILTER_DEFAULT_ERROR_EMA_GAIN        0.4f
+
+#if ANALOG_FILTER_NOISE_WINDOW < 2 || ANALOG_FILTER_NOISE_WINDOW > 65535
+#error "ANALOG_FILTER_NOISE_WINDOW needs to be between 2 and 65535 samples"
+#endif
+
+// One filter per axis
+#define ANALOG_FILTER_BANK_SIZE     MAX_NUMBER_OF_AXEN
+
+/*
+ * The state for a whole set of filters, kept as one array per field so a frame's worth of
+ * updates is one tight loop over contiguous memory. Slot i in every array is filter i.
+ */
 typedef struct {
-    uint16_t analog_resolution;
-    float snap_multiplier;
-    bool sleep_enable;
-    float activity_threshold;
-    bool edge_snap_enable;
-
-    float smooth_value;
-    //uint32_t last_activity_ms;
-    float error_ema;
-    bool sleeping;
-
-    uint16_t raw_value;
-    uint16_t responsive_value;
-    uint16_t previous_responsive_value;
-    bool responsive_value_has_changed;
+    uint8_t count;
+
+    // Settings
+    uint32_t analog_resolution[ANALOG_FILTER_BANK_SIZE];
+    analog_filter_gain snap_multiplier[ANALOG_FILTER_BANK_SIZE];
+    analog_filter_value activity_threshold[ANALOG_FILTER_BANK_SIZE];
+#if ANALOG_FILTER_FIXED_POINT
+    // Any diff at least this big is all the way up the snap curve
+    uint32_t snap_saturation_diff[ANALOG_FILTER_BANK_SIZE];
+#endif
+    analog_filter_gain error_ema_gain[ANALOG_FILTER_BANK_SIZE];
+    bool sleep_enable[ANALOG_FILTER_BANK_SIZE];
+    bool edge_snap_enable[ANALOG_FILTER_BANK_SIZE];
+
+    // State
+    analog_filter_value smooth_value[ANALOG_FILTER_BANK_SIZE];
+    analog_filter_value error_ema[ANALOG_FILTER_BANK_SIZE];
+    bool sleeping[ANALOG_FILTER_BANK_SIZE];
+
+    // Noise estimation. Welford's running variance of the raw input while the filter's asleep,
+    // in Q20.12 no matter which math the filter uses.
+    bool noise_adaptation_enable[ANALOG_FILTER_BANK_SIZE];
+    uint32_t noise_threshold_min[ANALOG_FILTER_BANK_SIZE];     // Whole counts
+    uint32_t noise_threshold_max[ANALOG_FILTER_BANK_SIZE];
+    uint16_t noise_count[ANALOG_FILTER_BANK_SIZE];
+    int32_t noise_mean[ANALOG_FILTER_BANK_SIZE];
+    uint64_t noise_m2[ANALOG_FILTER_BANK_SIZE];
+    uint32_t noise_floor[ANALOG_FILTER_BANK_SIZE];             // Standard deviation, 0 until there's one
+
+    // In and out
+    uint16_t raw_value[ANALOG_FILTER_BANK_SIZE];
+    uint16_t responsive_value[ANALOG_FILTER_BANK_SIZE];
+    bool responsive_value_has_changed[ANALOG_FILTER_BANK_SIZE];
+} analog_filter_bank;
+
+/*
+ * A view of one filter in a bank. It's small and safe to copy around, everything it points
+ * at lives in the bank.
+ */
+typedef struct {
+    analog_filter_bank *bank;
+    uint8_t slot;
 } analog_filter;
 
+// Where create_analog_filter() puts things
+extern analog_filter_bank analog_filter_default_bank;
+
+void analog_filter_bank_init(analog_filter_bank *bank);
+analog_filter analog_filter_bank_add(analog_filter_bank *bank, bool sleep_enable, float snap_multiplier);
+void analog_filter_bank_update(analog_filter_bank *bank);
 
 analog_filter create_analog_filter(bool sleep_enable, float snap_multiplier);
 uint16_t analog_filter_get_raw_value(analog_filter* filter);
 uint16_t analog_filter_get_value(analog_filter* filter);
 bool analog_filter_has_changed(analog_filter* filter);
 bool analog_filter_is_sleeping(analog_filter* filter);
+void analog_filter_set_input(analog_filter* filter, uint16_t raw_value);
 void analog_filter_update(analog_filter* filter, uint16_t raw_value);
 
 void analog_filter_set_snap_multiplier(analog_filter* filter, float new_multiplier);
@@ -76,11 +144,23 @@ void analog_filter_disable_sleep(analog_filter* filter);
 void analog_filter_enable_edge_snap(analog_filter* filter);
 void analog_filter_disable_edge_snap(analog_filter* filter);
 void analog_filter_set_activity_threshold(analog_filter* filter, float new_threshold);
-void analog_filter_set_analog_resolution(analog_filter* filter, uint16_t resolution);
+void analog_filter_set_analog_resolution(analog_filter* filter, uint32_t resolution);
+float analog_filter_get_activity_threshold(analog_filter* filter);
+
+void analog_filter_enable_noise_adaptation(analog_filter* filter, float min_threshold, float max_threshold);
+void analog_filter_disable_noise_adaptation(analog_filter* filter);
+float analog_filter_get_noise_floor(analog_filter* filter);
+
+// Both versions of the update call this after every sample
+void analog_filter_track_noise(analog_filter_bank *bank, uint8_t i, uint16_t raw_value);
 
 uint16_t analog_filter_get_responsive_value(analog_filter* filter, uint16_t new_value);
 float analog_filter_snap_curve(float x);
 
+#if ANALOG_FILTER_FIXED_POINT
+uint32_t analog_filter_snap_curve_q16(uint32_t x);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+    Fixed point version of the responsive filter's update, for the RP2040. See
+    responsive_analog_read_filter.c for where it came from and the original licence.
+
+    It follows the float version step for step, including where that one truncates to a
+    whole number, so the two agree to within a count or so.
+ */
+
+#include <stdlib.h>
+
+#include "pico/platform.h"
+
+#include "responsive_analog_read_filter.h"
+#include "snap_curve_table.h"
+
+#if ANALOG_FILTER_FIXED_POINT
+
+#define ONE_VALUE           (1 << ANALOG_FILTER_VALUE_SHIFT)
+
+/**
+ * Multiply a value by a Q16 gain, which is never negative and never more than one. The M0+
+ * only has a 32x32->32 multiply, and the compiler's 64 bit one is a call into flash, so it's
+ * split in two: the top of the value times the gain can't overflow, and neither can the
+ * bottom 16 bits times it. It comes out exactly the same as the 64 bit multiply and shift.
+ */
+static __force_inline int32_t apply_gain(int32_t value, int32_t gain) {
+    int32_t high = (value >> 16) * gain;
+    uint32_t low = ((uint32_t)value & 0xFFFFu) * (uint32_t)gain;
+    return high + (int32_t)(low >> 16);
+}
+
+static __force_inline uint16_t responsive_value(analog_filter_bank *bank, uint8_t i, uint16_t new_value) {
+
+    int32_t top = (int32_t)(bank->analog_resolution[i] - 1) << ANALOG_FILTER_VALUE_SHIFT;
+    int32_t value = (int32_t)new_value << ANALOG_FILTER_VALUE_SHIFT;
+
+    // Edge snap, same as the float version
+    if(bank->sleep_enable[i] && bank->edge_snap_enable[i]) {
+
+        int32_t resolution = (int32_t)bank->analog_resolution[i] << ANALOG_FILTER_VALUE_SHIFT;
+
+        if(value < bank->activity_threshold[i]) {
+            value = (value * 2) - bank->activity_threshold[i];
+        }
+        else if(value > resolution - bank->activity_threshold[i]) {
+            value = (value * 2) - resolution + bank->activity_threshold[i];
+        }
+
+        if(value < 0) {
+            value = 0;
+        }
+        else if(value > top) {
+            value = top;
+        }
+
+        // The float version puts this back in a uint16_t, which drops the fraction
+        value &= ~(ONE_VALUE - 1);
+    }
+
+    int32_t error = value - bank->smooth_value[i];
+
+    // Whole counts, like abs() on a float does
+    uint32_t diff = (uint32_t)abs(error) >> ANALOG_FILTER_VALUE_SHIFT;
+
+    bank->error_ema[i] += apply_gain(error - bank->error_ema[i], bank->error_ema_gain[i]);
+
+    if(bank->sleep_enable[i]) {
+        bank->sleeping[i] = abs(bank->error_ema[i]) < bank->activity_threshold[i];
+    }
+
+    if(bank->sleep_enable[i] && bank->sleeping[i]) {
+        return (uint16_t)(bank->smooth_value[i] >> ANALOG_FILTER_VALUE_SHIFT);
+    }
+
+    uint32_t snap = diff >= bank->snap_saturation_diff[i]
+            ? ANALOG_FILTER_GAIN_ONE
+            : snap_curve_lookup((diff * (uint32_t)bank->snap_multiplier[i]) >> (ANALOG_FILTER_SNAP_SHIFT - 16));
+
+    bank->smooth_value[i] += apply_gain(error, (int32_t)snap);
+
+    if(bank->smooth_value[i] < 0) {
+        bank->smooth_value[i] = 0;
+    }
+    else if(bank->smooth_value[i] > top) {
+        bank->smooth_value[i] = top;
+    }
+
+    return (uint16_t)(bank->smooth_value[i] >> ANALOG_FILTER_VALUE_SHIFT);
+}
+
+uint16_t analog_filter_get_responsive_value(analog_filter* filter, uint16_t new_value) {
+    uint16_t value = responsive_value(filter->bank, filter->slot, new_value);
+    analog_filter_track_noise(filter->bank, filter->slot, new_value);
+    return value;
+}
+
+static __force_inline void update_slot(analog_filter_bank *bank, uint8_t i) {
+    uint16_t value = responsive_value(bank, i, bank->raw_value[i]);
+    analog_filter_track_noise(bank, i, bank->raw_value[i]);
+    bank->responsive_value_has_changed[i] = value != bank->responsive_value[i];
+    bank->responsive_value[i] = value;
+}
+
+/**
+ * Run every filter in the bank on whatever was last staged with analog_filter_set_input()
+ *
+ * Four at a time and then whatever's left. Everything it calls is either inlined or in RAM
+ * too, so a frame never waits on the flash.
+ */
+void __not_in_flash_func(analog_filter_bank_update)(analog_filter_bank *bank) {
+
+    uint8_t i = 0;
+    for(; i + 4 <= bank->count; i += 4) {
+        update_slot(bank, i);
+        update_slot(bank, i + 1);
+        update_slot(bank, i + 2);
+        update_slot(bank, i + 3);
+    }
+    for(; i < bank->count; i++) {
+        update_slot(bank, i);
+    }
+}
+
+/**
+ * analog_filter_snap_curve() in Q16. (1 - 1/(x+1)) * 2 is the same as 2x/(x+1), which
+ * hits 1 at x = 1. It comes out of the table in snap_curve_table.h, so there's no divide.
+ */
+uint32_t analog_filter_snap_curve_q16(uint32_t x) {
+    return snap_curve_lookup(x);
+}
+
+#endif
@@ -0,0 +1,126 @@
+
+#include "pico/stdlib.h"
+#include "pico/time.h"
+
+#include "controller-config.h"
+
+#include "joystick/adc_scan.h"
+#include "joystick/sample_clock.h"
+
+#include "logging/logging.h"
+
+
+static repeating_timer_t sample_timer;
+static alarm_pool_t *sample_pool;
+static TaskHandle_t button_reader_task_handle;
+
+static volatile uint64_t last_tick_us = 0;
+static volatile uint32_t ticks = 0;
+
+// How much later (or earlier) the next tick should be than the interval, and how far off it was
+static volatile int32_t nudge_us = 0;
+static volatile int32_t phase_error_us = 0;
+
+
+static bool sample_clock_callback(repeating_timer_t *rt);
+
+
+void sample_clock_start(TaskHandle_t button_reader_task) {
+
+    button_reader_task_handle = button_reader_task;
+
+    // The default alarm pool's IRQ is on core 0. A pool of its own gets its IRQ on whichever
+    // core this is called from, which is the one the readers are on.
+    sample_pool = alarm_pool_create_with_unused_hardware_alarm(1);
+
+    // A negative delay means start to start
+    if(!alarm_pool_add_repeating_timer_us(sample_pool, -(int64_t)SAMPLE_CLOCK_INTERVAL_US,
+                                          sample_clock_callback, NULL, &sample_timer)) {
+        fatal("unable to start the sample clock");
+        return;
+    }
+
+    info("sample clock running every %uus on core %u", SAMPLE_CLOCK_INTERVAL_US, alarm_pool_core_num(sample_pool));
+}
+
+uint64_t sample_clock_last_tick_us() {
+
+    // It's 64 bits, so the IRQ could change it between the two halves
+    uint64_t tick;
+    do {
+        tick = last_tick_us;
+    } while(tick != last_tick_us);
+
+    return tick;
+}
+
+uint32_t sample_clock_ticks() {
+    return ticks;
+}
+
+/**
+ * @brief Steer the clock so a tick lands on target_us
+ *
+ * Any whole number of intervals before or after target_us is just as good, so this only cares
+ * about the phase. Call it as often as there's a new target, the last call before a tick wins.
+ *
+ * @param target_us the time_us_64() a tick should happen at
+ */
+void sample_clock_align(uint64_t target_us) {
+
+    uint64_t next_tick_us = sample_clock_last_tick_us() + SAMPLE_CLOCK_INTERVAL_US;
+
+    // How far the next tick would have to move, whichever way is shorter
+    int32_t error = (int32_t)((int64_t)(target_us - next_tick_us) % SAMPLE_CLOCK_INTERVAL_US);
+    if(error >= (int32_t)SAMPLE_CLOCK_INTERVAL_US / 2) {
+        error -= SAMPLE_CLOCK_INTERVAL_US;
+    }
+    else if(error < -(int32_t)SAMPLE_CLOCK_INTERVAL_US / 2) {
+        error += SAMPLE_CLOCK_INTERVAL_US;
+    }
+
+    phase_error_us = error;
+
+    if(error > SAMPLE_CLOCK_MAX_NUDGE_US) {
+        error = SAMPLE_CLOCK_MAX_NUDGE_US;
+    }
+    else if(error < -SAMPLE_CLOCK_MAX_NUDGE_US) {
+        error = -SAMPLE_CLOCK_MAX_NUDGE_US;
+    }
+
+    nudge_us = error;
+}
+
+/**
+ * How far off the last target the clock was when it was aligned
+ */
+int32_t sample_clock_phase_error_us() {
+    return phase_error_us;
+}
+
+
+/**
+ * Runs in the timer IRQ, so keep it short
+ */
+static bool sample_clock_callback(repeating_timer_t *rt) {
+
+    last_tick_us = time_us_64();
+    ticks++;
+
+    // The pool reads the delay after this returns, so this moves the next tick. A nudge is only
+    // good for one tick, the next one goes back to the interval unless it gets another.
+    rt->delay_us = -((int64_t)SAMPLE_CLOCK_INTERVAL_US + nudge_us);
+    nudge_us = 0;
+
+#if !ADC_SCAN_FREE_RUNNING
+    adc_scan_start_frame();
+#endif
+
+    if(button_reader_task_handle != NULL && ticks % SAMPLE_CLOCK_TICKS_PER_BUTTON_READ == 0) {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+        xTaskNotifyFromISR(button_reader_task_handle, SAMPLE_CLOCK_BUTTON_SWEEP, eSetBits, &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
+    }
+
+    return true;
+}
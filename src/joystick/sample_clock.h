@@ -0,0 +1,56 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "controller-config.h"
+
+/**
+ * Hardware timer that paces the readers
+ *
+ * A repeating timer fires every SAMPLE_CLOCK_INTERVAL_US, measured start to start so the
+ * time spent handling a tick doesn't push the next one back. Each tick kicks off an ADC
+ * frame (unless the scan engine paces itself), and every SAMPLE_CLOCK_TICKS_PER_BUTTON_READ
+ * ticks it wakes up the button reader with SAMPLE_CLOCK_BUTTON_SWEEP set in its notification
+ * value.
+ *
+ * It can be steered onto something else's schedule (the USB start of frame) with
+ * sample_clock_align(). It only moves SAMPLE_CLOCK_MAX_NUDGE_US a tick, so the readers never
+ * see a big jump in the frame rate, it just walks over. With the PIO backend the ADC frames
+ * don't come from the clock, so that only moves the buttons.
+ *
+ * The timer has an alarm pool to itself, so its IRQ is on whichever core called
+ * sample_clock_start().
+ */
+
+#define SAMPLE_CLOCK_INTERVAL_US    (1000000 / ADC_FRAME_RATE_HZ)
+
+// The debouncers count reads, so the buttons stay at their own rate even if the ADC speeds up
+#define SAMPLE_CLOCK_TICKS_PER_BUTTON_READ  (ADC_FRAME_RATE_HZ / BUTTON_READ_RATE_HZ)
+
+// What the button reader gets notified with, so it can tell a sweep from the button scanner
+#define SAMPLE_CLOCK_BUTTON_SWEEP   (1u << 0)
+
+#if (ADC_FRAME_RATE_HZ % BUTTON_READ_RATE_HZ) != 0
+#error "ADC_FRAME_RATE_HZ has to be a multiple of BUTTON_READ_RATE_HZ"
+#endif
+
+void sample_clock_start(TaskHandle_t button_reader_task);
+
+uint64_t sample_clock_last_tick_us();
+uint32_t sample_clock_ticks();
+
+void sample_clock_align(uint64_t target_us);
+int32_t sample_clock_phase_error_us();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,103 @@
+
+/*
+ * Builds the snap curve table at compile time, and makes sure it's close enough to the
+ * real curve before letting the build go any further.
+ */
+
+#include <array>
+#include <cstdint>
+
+#include "pico/platform.h"
+
+#include "snap_curve_table.h"
+
+#if SNAP_CURVE_TABLE_BITS < 1 || SNAP_CURVE_TABLE_BITS > 12
+#error "SNAP_CURVE_TABLE_BITS needs to be between 1 and 12"
+#endif
+
+namespace {
+
+    constexpr uint32_t table_size = SNAP_CURVE_TABLE_SEGMENTS + 1;
+
+    /**
+     * 2x/(x+1) in Q16, rounded to the nearest count. This is what the table gets checked against.
+     */
+    constexpr uint32_t exact_snap_curve(uint32_t x) {
+
+        if(x >= SNAP_CURVE_ONE) {
+            return SNAP_CURVE_ONE;
+        }
+
+        uint64_t numerator = 2ull * x * SNAP_CURVE_ONE;
+        uint64_t denominator = x + SNAP_CURVE_ONE;
+        return (uint32_t)((numerator + denominator / 2) / denominator);
+    }
+
+    constexpr std::array<uint32_t, table_size> build_table() {
+
+        std::array<uint32_t, table_size> table{};
+        for(uint32_t i = 0; i < table_size; i++) {
+            table[i] = exact_snap_curve(i << SNAP_CURVE_TABLE_SHIFT);
+        }
+        return table;
+    }
+}
+
+/*
+ * std::array is laid out exactly like a plain array, so to the C side this is just the
+ * uint32_t[] that snap_curve_table.h says it is. It's in RAM, since the filter looks it up
+ * from RAM on every update.
+ */
+extern "C" __not_in_flash("snap_curve") constexpr std::array<uint32_t, table_size> snap_curve_table = build_table();
+
+static_assert(sizeof(snap_curve_table) == sizeof(uint32_t) * table_size, "the C side expects a plain array");
+
+namespace {
+
+    /**
+     * Same thing snap_curve_lookup() does, but at compile time
+     */
+    constexpr uint32_t lookup(uint32_t x) {
+
+        uint32_t index = x >> SNAP_CURVE_TABLE_SHIFT;
+
+#if SNAP_CURVE_TABLE_INTERPOLATE
+        uint32_t fraction = x & ((1u << SNAP_CURVE_TABLE_SHIFT) - 1);
+        uint32_t low = snap_curve_table[index];
+        uint32_t high = snap_curve_table[index + 1];
+        return low + (((high - low) * fraction) >> SNAP_CURVE_TABLE_SHIFT);
+#else
+        return snap_curve_table[index];
+#endif
+    }
+
+    /**
+     * Walk every input below 1 and find the worst miss, in Q16 counts
+     */
+    constexpr uint32_t worst_error() {
+
+        uint32_t worst = 0;
+        for(uint32_t x = 0; x < SNAP_CURVE_ONE; x++) {
+            uint32_t expected = exact_snap_curve(x);
+            uint32_t actual = lookup(x);
+            uint32_t error = actual > expected ? actual - expected : expected - actual;
+            if(error > worst) {
+                worst = error;
+            }
+        }
+        return worst;
+    }
+
+    // Steepest part of the curve is a slope of 2 at x = 0, so a step without interpolation is
+    // worth up to two segments. With it, the curve's so gentle that a count or two is all it costs.
+#if SNAP_CURVE_TABLE_INTERPOLATE
+    constexpr uint32_t allowed_error = SNAP_CURVE_TABLE_MAX_ERROR;
+#else
+    constexpr uint32_t allowed_error = SNAP_CURVE_TABLE_MAX_ERROR + (2u << SNAP_CURVE_TABLE_SHIFT);
+#endif
+
+    static_assert(snap_curve_table[0] == 0, "the snap curve starts at 0");
+    static_assert(snap_curve_table[table_size - 1] == SNAP_CURVE_ONE, "the snap curve ends at 1");
+    static_assert(worst_error() <= allowed_error,
+                  "the snap curve table is too far off, use more SNAP_CURVE_TABLE_BITS or turn on interpolation");
+}
@@ -0,0 +1,62 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "controller-config.h"
+
+/*
+ * The responsive filter's snap curve, 2x/(x+1) capped at 1, as a lookup table in Q16.
+ *
+ * The input is the diff times the snap multiplier, so the table doesn't care what the
+ * multiplier is. Changing it only changes where a diff lands in the table, and that's
+ * already worked out when the multiplier is set. Anything at or past 1 is the flat part
+ * of the curve and never gets looked up.
+ *
+ * The table is built at compile time by snap_curve_table.cpp, which also checks that it's
+ * within SNAP_CURVE_TABLE_MAX_ERROR of the real curve before it'll build.
+ */
+
+#define SNAP_CURVE_ONE              (1u << 16)
+#define SNAP_CURVE_TABLE_SEGMENTS   (1u << SNAP_CURVE_TABLE_BITS)
+#define SNAP_CURVE_TABLE_SHIFT      (16 - SNAP_CURVE_TABLE_BITS)
+
+// The C++ side defines this as a std::array, which has the same layout
+#ifndef __cplusplus
+
+// There's one more point than there are segments so the last one has something to interpolate to
+extern const uint32_t snap_curve_table[SNAP_CURVE_TABLE_SEGMENTS + 1];
+
+/**
+ * Look up the snap curve for x in Q16. No divide, and with interpolation only one multiply.
+ */
+static inline uint32_t snap_curve_lookup(uint32_t x) {
+
+    if(x >= SNAP_CURVE_ONE) {
+        return SNAP_CURVE_ONE;
+    }
+
+    uint32_t index = x >> SNAP_CURVE_TABLE_SHIFT;
+
+#if SNAP_CURVE_TABLE_INTERPOLATE
+    uint32_t fraction = x & ((1u << SNAP_CURVE_TABLE_SHIFT) - 1);
+    uint32_t low = snap_curve_table[index];
+    uint32_t high = snap_curve_table[index + 1];
+
+    // The curve only ever goes up, so this can't go negative
+    return low + (((high - low) * fraction) >> SNAP_CURVE_TABLE_SHIFT);
+#else
+    return snap_curve_table[index];
+#endif
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,10 +4,13 @@
 #include <FreeRTOS.h>
 #include <task.h>
 
+#include "joystick/button_events.h"
+#include "joystick/controller_state.h"
 #include "joystick/joystick.h"
 #include "lights/colors.h"
 #include "lights/status_lights.h"
 #include "logging/logging.h"
+#include "tasks/tasks.h"
 #include "util/ranges.h"
 
 #include "controller-config.h"
@@ -20,10 +23,7 @@ extern bool device_mounted;
 
 // Axii!
 extern uint8_t number_of_axen;
-extern axis* axis_collection[MAX_NUMBER_OF_AXEN];
 
-// Buttons
-extern button_t button_state_mask;
 
 
 uint8_t status_lights_state_machine;
@@ -55,12 +55,13 @@ void status_lights_init() {
 void status_lights_start() {
     info("starting up the status lights!");
 
-    xTaskCreate(status_lights_task,
-                "status_lights",
-                configMINIMAL_STACK_SIZE + 512,
-                (void*)0,
-                1,
-                &status_lights_handle);
+    xTaskCreateAffinitySet(status_lights_task,
+                           "status_lights",
+                           configMINIMAL_STACK_SIZE + 512,
+                           (void*)0,
+                           STATUS_LIGHTS_TASK_PRIORITY,
+                           TASK_CORE_MASK(STATUS_LIGHTS_TASK_CORE),
+                           &status_lights_handle);
 
 }
 
@@ -101,6 +102,17 @@ portTASK_FUNCTION(status_lights_task, pvParameters) {
     uint32_t axis_color[MAX_NUMBER_OF_AXEN] = {0};
     uint32_t button_color[MAX_NUMBER_OF_BUTTONS] = {0};
 
+    // The lights follow the button events like the USB side does
+    button_event_cursor button_cursor;
+    button_event_cursor_init(&button_cursor);
+    button_t lit_buttons = 0;
+    for(uint8_t i = 0; i < MAX_NUMBER_OF_BUTTONS; i++) {
+        if(button_is_pressed(i)) {
+            setButton(&lit_buttons, i);
+        }
+    }
+    button_event event;
+
 
 
 
@@ -129,13 +141,16 @@ portTASK_FUNCTION(status_lights_task, pvParameters) {
         controller_state_color = 0;
 
 
-        // Look at each of the axii in use
-        for(uint i = 0; i < number_of_axen; i++) {
+        // Look at each of the axii in use, all from the same frame
+        controller_state state;
+        controller_state_read(&state);
+
+        for(uint i = 0; i < state.number_of_axes; i++) {
 
             // Convert the position to a hue
-            uint16_t hue = convertRange(axis_collection[i]->filtered_value,
+            uint16_t hue = convertRange(state.axes[i],
                                    0,
-                                   UINT8_MAX,
+                                   HID_AXIS_MAX,
                                    0,              // 0 is red
                                    23300);         // 233 * 100 (233 is blue)
 
@@ -151,8 +166,17 @@ portTASK_FUNCTION(status_lights_task, pvParameters) {
 
         }
 
+        while(button_event_next(&button_cursor, &event)) {
+            if(event.pressed) {
+                setButton(&lit_buttons, event.button);
+            }
+            else {
+                clearButton(&lit_buttons, event.button);
+            }
+        }
+
         for (int i = 0; i < MAX_NUMBER_OF_BUTTONS; i++) {
-            if(button_state_mask & (1 << i)) {
+            if(lit_buttons & (1u << i)) {
                 button_color[i] = hsv_to_urgb(device_mounted_color);
             } else {
                 button_color[i] = 0;    // Zero means off
@@ -8,6 +8,7 @@
 #include "pico/time.h"
 
 #include "logging.h"
+#include "tasks/tasks.h"
 
 #include "usb/usb.h"
 
@@ -139,12 +140,13 @@ struct LogMessage createMessageObject(uint8_t level, const char *message, va_lis
 }
 
 void start_log_reader() {
-    xTaskCreate(log_queue_reader_task,
-                "log_queue_reader_task",
-                1512,
-                NULL,
-                1,
-                &log_queue_reader_task_handle);
+    xTaskCreateAffinitySet(log_queue_reader_task,
+                           "log_queue_reader_task",
+                           1512,
+                           NULL,
+                           LOG_READER_TASK_PRIORITY,
+                           TASK_CORE_MASK(LOG_READER_TASK_CORE),
+                           &log_queue_reader_task_handle);
 }
 
 /**
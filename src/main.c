@@ -6,6 +6,7 @@
 // FreeRTOS
 #include <FreeRTOS.h>
 #include <task.h>
+#include <timers.h>
 
 // TinyUSB
 #include "bsp/board.h"
@@ -20,9 +21,12 @@
 #include "display/display_task.h"
 #include "display/display_wrapper.h"
 #include "eeprom/eeprom.h"
+#include "joystick/calibration.h"
+#include "joystick/curve_store.h"
 #include "joystick/joystick.h"
 #include "lights/status_lights.h"
 #include "logging/logging.h"
+#include "tasks/tasks.h"
 #include "usb/usb.h"
 #include "usb/usb_descriptors.h"
 
@@ -132,6 +136,11 @@ int main(void)
     register_axis(&joystick2.z);
     register_axis(&pot2.z);
 
+    // Now that the axes are all there, give them their ranges and curves
+    calibration_init();
+    calibration_load();
+    curve_store_load();
+
     // And go!
     analog_reader_task_handler = start_analog_reader_task();
     button_reader_task_handler = start_button_reader_task();
@@ -143,12 +152,13 @@ int main(void)
 
     // Queue up the startup task for right after the scheduler starts
     TaskHandle_t startup_task_handle;
-    xTaskCreate(startup_task,
-                "startup_task",
-                configMINIMAL_STACK_SIZE,
-                NULL,
-                1,
-                &startup_task_handle);
+    xTaskCreateAffinitySet(startup_task,
+                           "startup_task",
+                           configMINIMAL_STACK_SIZE,
+                           NULL,
+                           STARTUP_TASK_PRIORITY,
+                           TASK_CORE_MASK(STARTUP_TASK_CORE),
+                           &startup_task_handle);
 
     vTaskStartScheduler();
 
@@ -168,6 +178,9 @@ portTASK_FUNCTION(startup_task, pvParameters) {
     usb_init();
     usb_start();
 
+    // Nothing on the timers is in a hurry anymore
+    vTaskCoreAffinitySet(xTimerGetTimerDaemonTaskHandle(), TASK_CORE_MASK(TIMER_TASK_CORE));
+
 
     // Bye!
     vTaskDelete(NULL);
@@ -0,0 +1,135 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "controller-config.h"
+
+#include "tasks/tasks.h"
+
+typedef struct {
+    UBaseType_t task_number;
+    configRUN_TIME_COUNTER_TYPE run_time;
+} task_baseline;
+
+// Where everything was at the last reset
+static task_baseline baselines[TASK_STATS_MAX_TASKS];
+static UBaseType_t number_of_baselines = 0;
+static configRUN_TIME_COUNTER_TYPE baseline_time = 0;
+
+// The last task_stats_take()
+static TaskStatus_t tasks[TASK_STATS_MAX_TASKS];
+static UBaseType_t number_of_tasks = 0;
+static configRUN_TIME_COUNTER_TYPE taken_time = 0;
+
+
+static configRUN_TIME_COUNTER_TYPE baseline_for(UBaseType_t task_number) {
+
+    for(UBaseType_t i = 0; i < number_of_baselines; i++) {
+        if(baselines[i].task_number == task_number) {
+            return baselines[i].run_time;
+        }
+    }
+
+    // Didn't exist yet, so all of its time is since the reset
+    return 0;
+}
+
+/**
+ * Hundredths of a percent of one core since the reset
+ */
+static uint32_t share_of_core(configRUN_TIME_COUNTER_TYPE run_time) {
+
+    configRUN_TIME_COUNTER_TYPE elapsed = taken_time - baseline_time;
+    if(elapsed == 0) {
+        return 0;
+    }
+
+    return (uint32_t)(((uint64_t)run_time * 10000) / elapsed);
+}
+
+static const TaskStatus_t* find_task(TaskHandle_t handle) {
+
+    for(UBaseType_t i = 0; i < number_of_tasks; i++) {
+        if(tasks[i].xHandle == handle) {
+            return &tasks[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Start the CPU numbers over from now
+ */
+void task_stats_reset() {
+
+    number_of_baselines = uxTaskGetSystemState(tasks, TASK_STATS_MAX_TASKS, &baseline_time);
+
+    for(UBaseType_t i = 0; i < number_of_baselines; i++) {
+        baselines[i].task_number = tasks[i].xTaskNumber;
+        baselines[i].run_time = tasks[i].ulRunTimeCounter;
+    }
+
+    number_of_tasks = 0;
+    taken_time = baseline_time;
+}
+
+/**
+ * Look at where every task is at right now, so the describe functions have something to say.
+ * Returns how many tasks there are.
+ */
+UBaseType_t task_stats_take() {
+
+    number_of_tasks = uxTaskGetSystemState(tasks, TASK_STATS_MAX_TASKS, &taken_time);
+    if(number_of_tasks == 0) {
+        // There's more than TASK_STATS_MAX_TASKS, and FreeRTOS won't give us part of them
+        return 0;
+    }
+
+    for(UBaseType_t i = 0; i < number_of_tasks; i++) {
+        tasks[i].ulRunTimeCounter -= baseline_for(tasks[i].xTaskNumber);
+    }
+
+    return number_of_tasks;
+}
+
+/**
+ * How busy a core was, which is whatever its idle task wasn't
+ */
+int task_stats_describe_core(uint8_t core, char *buf, size_t length) {
+
+    const TaskStatus_t *idle = find_task(xTaskGetIdleTaskHandleForCore(core));
+    uint32_t idle_share = idle != NULL ? share_of_core(idle->ulRunTimeCounter) : 0;
+    uint32_t busy = idle_share < 10000 ? 10000 - idle_share : 0;
+
+    return snprintf(buf, length, "core %u: %lu.%02lu%% busy",
+                    core, (unsigned long)(busy / 100), (unsigned long)(busy % 100));
+}
+
+int task_stats_describe_task(UBaseType_t task, char *buf, size_t length) {
+
+    if(task >= number_of_tasks) {
+        return snprintf(buf, length, "no task %lu", (unsigned long)task);
+    }
+
+    const TaskStatus_t *t = &tasks[task];
+    uint32_t share = share_of_core(t->ulRunTimeCounter);
+
+    const char *cores = "any";
+    if(t->uxCoreAffinityMask == (1u << 0)) {
+        cores = "0";
+    }
+    else if(t->uxCoreAffinityMask == (1u << 1)) {
+        cores = "1";
+    }
+
+    return snprintf(buf, length, "%s: core %s, priority %lu, cpu %lu.%02lu%%, stack free %lu",
+                    t->pcTaskName,
+                    cores,
+                    (unsigned long)t->uxCurrentPriority,
+                    (unsigned long)(share / 100), (unsigned long)(share % 100),
+                    (unsigned long)t->usStackHighWaterMark);
+}
@@ -0,0 +1,41 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "controller-config.h"
+
+/**
+ * Where the tasks run, and how much of each core they use
+ *
+ * Every task gets created with TASK_CORE_MASK() of the core its entry in the placement table
+ * in controller-config.h says. With TASKS_ON_ONE_CORE set they all get core 0 instead, and
+ * core 1 just idles, which is the easy way to see what the second core is buying us.
+ *
+ * The CPU numbers come from FreeRTOS's run time counters, which tick in microseconds. They're
+ * all since the last task_stats_reset(), and a task's percent is of one core.
+ */
+
+#if TASKS_ON_ONE_CORE
+#define TASK_CORE_MASK(core)    ((UBaseType_t)1 << 0)
+#else
+#define TASK_CORE_MASK(core)    ((UBaseType_t)1 << (core))
+#endif
+
+void task_stats_reset();
+UBaseType_t task_stats_take();
+int task_stats_describe_core(uint8_t core, char *buf, size_t length);
+int task_stats_describe_task(UBaseType_t task, char *buf, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -64,9 +64,8 @@ extern "C" {
   #error "Incorrect RHPort configuration"
 #endif
 
-#ifndef CFG_TUSB_OS
-#define CFG_TUSB_OS               OPT_OS_NONE
-#endif
+// CFG_TUSB_OS comes from TINYUSB_OPT_OS in CMakeLists.txt. The SDK puts it on the command
+// line, so it can't be set here. usb_device_task() needs OPT_OS_FREERTOS, and usb.c checks.
 
 // CFG_TUSB_DEBUG is defined by compiler in DEBUG build
 // #define CFG_TUSB_DEBUG           0
@@ -0,0 +1,113 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "controller-config.h"
+
+#include "tusb.h"
+
+/*
+ * The reports that go to the host. These have to match desc_hid_report, which
+ * usb_descriptor_check.cpp makes sure of.
+ */
+
+/**
+ * One axis in the HID report, signed and centered on zero
+ */
+#if HID_AXIS_BITS == 8
+typedef int8_t hid_axis_t;
+#else
+typedef int16_t hid_axis_t;
+#endif
+
+/**
+ * Our custom HID report
+ */
+typedef struct TU_ATTR_PACKED
+{
+    hid_axis_t x;      ///< Delta x  movement of left analog-stick
+    hid_axis_t y;      ///< Delta y  movement of left analog-stick
+    hid_axis_t z;      ///< Delta z  movement of right analog-joystick
+    hid_axis_t rz;     ///< Delta Rz movement of right analog-joystick
+    hid_axis_t rx;     ///< Delta Rx movement of analog left trigger
+    hid_axis_t ry;     ///< Delta Ry movement of analog right trigger
+    hid_axis_t left_dial;
+    hid_axis_t right_dial;
+    button_t buttons;  ///< Buttons mask for currently pressed buttons
+#if HID_EXTENDED_REPORT
+    uint8_t sequence;       ///< Goes up by one for every report that's queued, so the host can spot drops and repeats
+    uint32_t timestamp_us;  ///< Low 32 bits of time_us_64() when the frame in this report was done
+    uint8_t flags;          ///< HID_REPORT_FLAG_*
+#endif
+} creature_joystick_report_t;
+
+// The flags in an extended joystick report
+#define HID_REPORT_FLAG_FILTER_SLEEPING     (1u << 0)   ///< At least one axis is being held by its filter
+#define HID_REPORT_FLAG_CLIPPED             (1u << 1)   ///< At least one axis is pinned at the end of its calibration
+#define HID_REPORT_FLAG_STALE               (1u << 2)   ///< The frame already went out, or it's more than two frames old
+
+/*
+ * The history report (HID_HISTORY_REPORT). Every frame since the last one, oldest first, with
+ * the axes in the same order as the joystick report.
+ *
+ * The axes are the top HID_HISTORY_AXIS_BITS of the joystick report's, signed and centered on
+ * zero the same way, and packed little-endian. At 12 bits that's two axes in every three bytes,
+ * the first one in the low 12 bits.
+ */
+
+#if HID_HISTORY_REPORT
+
+#define HID_HISTORY_AXES        8
+
+#if HID_HISTORY_AXIS_BITS == 8
+#define HID_HISTORY_AXES_SIZE   HID_HISTORY_AXES
+#elif HID_HISTORY_AXIS_BITS == 12
+#define HID_HISTORY_AXES_SIZE   (HID_HISTORY_AXES * 3 / 2)
+#elif HID_HISTORY_AXIS_BITS == 16
+#define HID_HISTORY_AXES_SIZE   (HID_HISTORY_AXES * 2)
+#else
+#error "HID_HISTORY_AXIS_BITS has to be 8, 12, or 16"
+#endif
+
+#if HID_HISTORY_AXIS_BITS > HID_AXIS_BITS
+#error "HID_HISTORY_AXIS_BITS can't be more than HID_AXIS_BITS"
+#endif
+
+/**
+ * One frame in the history report
+ */
+typedef struct TU_ATTR_PACKED
+{
+    uint16_t age_us;                        ///< How long before timestamp_us this frame was read
+    uint8_t axes[HID_HISTORY_AXES_SIZE];    ///< HID_HISTORY_AXIS_BITS per axis, packed
+} creature_history_sample_t;
+
+// The header's the timestamp, count, and lost. The report ID takes the first byte of the endpoint.
+#define HID_HISTORY_HEADER_SIZE 6
+#define HID_HISTORY_SAMPLE_SIZE (2 + HID_HISTORY_AXES_SIZE)
+#define HID_HISTORY_SAMPLES     ((CFG_TUD_HID_EP_BUFSIZE - 1 - HID_HISTORY_HEADER_SIZE) / HID_HISTORY_SAMPLE_SIZE)
+
+// Any more than this between polls and the oldest ones never make it to the host
+#if HID_HISTORY_SAMPLE_RATE_HZ * POLLING_INTERVAL / 1000 > HID_HISTORY_SAMPLES
+#error "more frames come in every poll than fit in a history report, turn HID_HISTORY_SAMPLE_RATE_HZ down"
+#endif
+
+typedef struct TU_ATTR_PACKED
+{
+    uint32_t timestamp_us;                  ///< Low 32 bits of time_us_64() when the newest frame was read
+    uint8_t count;                          ///< How many of the samples are real
+    uint8_t lost;                           ///< Frames that never made it into a report since the last one
+    creature_history_sample_t samples[HID_HISTORY_SAMPLES];
+} creature_history_report_t;
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,15 +5,31 @@
 
 #include <sys/cdefs.h>
 #include <limits.h>
+#include <stddef.h>
+#include <string.h>
 
 #include <FreeRTOS.h>
 #include <task.h>
-#include <timers.h>
 
+#include "joystick/adc_scan.h"
+#include "joystick/button_events.h"
+#include "joystick/button_scan.h"
+#include "joystick/calibration.h"
+#include "joystick/curve_store.h"
+#include "joystick/controller_state.h"
 #include "joystick/joystick.h"
+#include "joystick/sample_clock.h"
 #include "logging/logging.h"
+#include "tasks/tasks.h"
 #include "usb/usb.h"
 #include "usb/usb_descriptors.h"
+#include "util/latency_stats.h"
+
+// tud_task() has to block on the stack's event queue, or usb_device_task() spins and starves
+// everything under it on the USB core
+#if CFG_TUSB_OS != OPT_OS_FREERTOS
+#error "TinyUSB has to be built with OPT_OS_FREERTOS, see TINYUSB_OPT_OS in CMakeLists.txt"
+#endif
 
 uint32_t reports_sent = 0;
 bool usb_bus_active = false;
@@ -26,7 +42,80 @@ extern pot pot1;
 extern joystick joystick2;
 extern pot pot2;
 
-extern button_t button_state_mask;
+// What the host has been told about the buttons, which runs from the button events
+static button_t reported_buttons = 0;
+static button_event_cursor button_cursor;
+static uint32_t buttons_lost = 0;
+
+static TaskHandle_t usb_device_task_handle;
+static TaskHandle_t hid_task_handle;
+
+// Why the HID task woke up, as notification bits
+#define HID_WAKE_TICK       (1u << 0)
+#define HID_WAKE_BUTTON     (1u << 1)
+#define HID_WAKE_FRAME      (1u << 2)
+
+// With SOF sync the frames drive the reports, otherwise there's one every tick. The frames
+// still only wait a poll (and a tick, so one that's on time isn't beaten to it), so a reader
+// that's stalled or suspended can't take the device off the air.
+#if USB_SOF_SYNC
+#define HID_TASK_WAIT       (pdMS_TO_TICKS(POLLING_INTERVAL) + 1)
+#else
+#define HID_TASK_WAIT       pdMS_TO_TICKS(1)
+#endif
+
+static uint32_t button_reports_sent = 0;
+
+// The last report that went out, so one that's the same can be skipped. An idle interval of
+// 0 means only when something changes.
+static creature_joystick_report_t last_report;
+static uint64_t last_report_us = 0;
+static bool last_report_valid = false;
+static volatile uint32_t idle_interval_us = HID_DEFAULT_IDLE_MS * 1000;
+static uint32_t reports_suppressed = 0;
+static uint32_t get_reports_answered = 0;
+
+// Whether a report changed only looks at the axes and buttons. The extended report's
+// sequence number and timestamp are different every time.
+#define HID_REPORT_STATE_SIZE   (offsetof(creature_joystick_report_t, buttons) + sizeof(button_t))
+
+#if HID_EXTENDED_REPORT
+// What the next report's sequence number will be, and which frame the last one had
+static uint8_t report_sequence = 0;
+static uint32_t last_report_frame = 0;
+#endif
+
+#if HID_HISTORY_REPORT
+// Where the history reports are in the controller state history
+static controller_state_cursor history_cursor;
+static uint32_t history_reports_sent = 0;
+static uint32_t history_samples_sent = 0;
+static uint32_t history_samples_lost = 0;
+#endif
+
+// How old the frame is when its report goes out, and how long a button took to get reported
+static latency_stats frame_age;
+static latency_stats button_latency;
+
+// How old the frame is when the host picks it up, and how long it took from the sample clock
+// ticking to its report being queued
+static latency_stats in_token_age;
+static latency_stats tick_to_report;
+static uint64_t queued_frame_us = 0;
+
+#if USB_SOF_SYNC
+// The frame number from the last SOF, and which frames (mod POLLING_INTERVAL) the host polls in
+static volatile uint32_t last_sof_frame = 0;
+static volatile uint8_t host_poll_phase = 0;
+static uint32_t sofs_seen = 0;
+
+static void usb_frame_listener(const controller_state *state);
+#endif
+
+static void usb_button_event_listener(const button_event *event);
+
+extern uint8_t number_of_axen;
+extern axis* axis_collection[MAX_NUMBER_OF_AXEN];
 
 extern TaskHandle_t analog_reader_task_handler;
 extern TaskHandle_t button_reader_task_handler;
@@ -55,52 +144,153 @@ void usb_init() {
 
 void usb_start() {
 
-    TimerHandle_t usbDeviceTimer = xTimerCreate(
-            "usbDeviceTimer",              // Timer name
-            pdMS_TO_TICKS(1),            // Every millisecond
-            pdTRUE,                          // Auto-reload
-            (void *) 0,                        // Timer ID (not used here)
-            usbDeviceTimerCallback         // Callback function
-    );
+    latency_stats_init(&frame_age);
+    latency_stats_init(&button_latency);
+    latency_stats_init(&in_token_age);
+    latency_stats_init(&tick_to_report);
+
+    xTaskCreateAffinitySet(usb_device_task,
+                           "usb_device_task",
+                           USBD_STACK_SIZE,
+                           NULL,
+                           USB_DEVICE_TASK_PRIORITY,
+                           TASK_CORE_MASK(USB_DEVICE_TASK_CORE),
+                           &usb_device_task_handle);
+
+    xTaskCreateAffinitySet(hid_task,
+                           "hid_task",
+                           HID_STACK_SIZE,
+                           NULL,
+                           HID_TASK_PRIORITY,
+                           TASK_CORE_MASK(HID_TASK_CORE),
+                           &hid_task_handle);
+
+    button_event_cursor_init(&button_cursor);
+    button_events_set_listener(usb_button_event_listener);
+
+#if HID_HISTORY_REPORT
+    controller_state_cursor_init(&history_cursor);
+#endif
 
-    TimerHandle_t hidTaskTimer = xTimerCreate(
-            "hidTaskTimer",              // Timer name
-            pdMS_TO_TICKS(1),            // Every millisecond
-            pdTRUE,                          // Auto-reload
-            (void *) 0,                        // Timer ID (not used here)
-            usb_hid_task_callback         // Callback function
-    );
+#if USB_SOF_SYNC
+    // Every frame goes out as soon as it's done, and the SOFs keep the frames in step with the host
+    controller_state_set_listener(usb_frame_listener);
+    tud_sof_cb_enable(true);
+#endif
 
-    // Something's gone really wrong if we can't create the timer
-    configASSERT (usbDeviceTimer != NULL);
+    info("USB tasks started");
 
-    // Start timers
-    xTimerStart(usbDeviceTimer, 0);
-    xTimerStart(hidTaskTimer, 0);
+}
 
-    info("USB service timers started");
 
-}
+/**
+ * Runs the TinyUSB device stack. tud_task() sleeps on the stack's event queue until the USB
+ * IRQ puts something in it, so control transfers, CDC, and the HID callbacks get handled as
+ * soon as they happen.
+ */
+portTASK_FUNCTION(usb_device_task, pvParameters) {
+
+    debug("hello from the USB device task");
 
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
 
+    for(EVER) {
+        tud_task();
+    }
 
-void usbDeviceTimerCallback(TimerHandle_t xTimer) {
-    tud_task();
+#pragma clang diagnostic pop
 }
 
-void usb_hid_task_callback(TimerHandle_t xTimer) {
+/**
+ * Sends the HID reports. It sleeps until a button changes or a frame is done, or until it's
+ * been HID_TASK_WAIT since the last one.
+ */
+portTASK_FUNCTION(hid_task, pvParameters) {
+
+    debug("hello from the HID task");
+
+    uint32_t reasons;
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+
+    for(EVER) {
+
+        if(xTaskNotifyWait(0, UINT32_MAX, &reasons, HID_TASK_WAIT) == pdFALSE) {
+            reasons = HID_WAKE_TICK;
+        }
+
+        // Remote wakeup
+        if (tud_suspended()) {
+            // Wake up host if we are in suspend mode
+            // and REMOTE_WAKEUP feature is enabled by host
+            tud_remote_wakeup();
+        }
+
+#if USB_SOF_SYNC
+        if(reasons & HID_WAKE_FRAME) {
 
-    // Remote wakeup
-    if (tud_suspended()) {
-        // Wake up host if we are in suspend mode
-        // and REMOTE_WAKEUP feature is enabled by host
-        tud_remote_wakeup();
+            // Only counts if it's still the tick that started this frame
+            uint32_t since_tick = (uint32_t)(time_us_64() - sample_clock_last_tick_us());
+            if(since_tick < SAMPLE_CLOCK_INTERVAL_US) {
+                latency_stats_record(&tick_to_report, since_tick);
+            }
+        }
+#endif
+
+        send_hid_report();
+        events_processed++;
+
+        if(reasons & HID_WAKE_BUTTON) {
+            button_reports_sent++;
+        }
     }
 
-    send_hid_report();
-    events_processed++;
+#pragma clang diagnostic pop
+}
+
+/**
+ * A button changed, so send a report now instead of waiting for the next one. This runs on
+ * the button reader, so it just pokes the HID task.
+ */
+static void usb_button_event_listener(const button_event *event) {
+
+    (void) event;
+
+    xTaskNotify(hid_task_handle, HID_WAKE_BUTTON, eSetBits);
+}
+
+#if USB_SOF_SYNC
+
+/**
+ * A new frame is done, same deal as a button
+ */
+static void usb_frame_listener(const controller_state *state) {
+
+    (void) state;
+
+    xTaskNotify(hid_task_handle, HID_WAKE_FRAME, eSetBits);
 }
 
+/**
+ * Start of frame, once a millisecond while the bus is up. The host only polls every
+ * POLLING_INTERVAL frames, so only the SOFs of the frames it polls in steer the sample clock.
+ */
+void tud_sof_cb(uint32_t frame_count) {
+
+    uint64_t now = time_us_64();
+
+    last_sof_frame = frame_count;
+    sofs_seen++;
+
+    if(frame_count % POLLING_INTERVAL == host_poll_phase) {
+        sample_clock_align(now + (POLLING_INTERVAL * 1000) - USB_SOF_LEAD_US);
+    }
+}
+
+#endif
+
 
 
 
@@ -109,12 +299,44 @@ void usb_hid_task_callback(TimerHandle_t xTimer) {
 // Device callbacks
 //--------------------------------------------------------------------+
 
+#if SUSPEND_READER_WHEN_NO_USB
+
+/**
+ * The readers only run while there's a host to report to. The HID task is woken by what they
+ * read, so this can't be left to the report path.
+ */
+static void set_readers_running(bool running) {
+
+    bool suspended = eTaskGetState(analog_reader_task_handler) == eSuspended;
+
+    if(running && suspended) {
+        debug("resuming the readers");
+        vTaskResume(analog_reader_task_handler);
+        vTaskResume(button_reader_task_handler);
+    }
+    else if(!running && !suspended) {
+        debug("suspending the readers");
+        vTaskSuspend(analog_reader_task_handler);
+        vTaskSuspend(button_reader_task_handler);
+    }
+}
+
+#endif
+
 // Invoked when device is mounted
 void tud_mount_cb(void)
 {
     debug("device mounted");
     device_mounted = true;
     usb_bus_active = true;
+
+    // A new host hasn't been told anything yet
+    idle_interval_us = HID_DEFAULT_IDLE_MS * 1000;
+    last_report_valid = false;
+
+#if SUSPEND_READER_WHEN_NO_USB
+    set_readers_running(true);
+#endif
 }
 
 // Invoked when device is unmounted
@@ -122,6 +344,10 @@ void tud_umount_cb(void)
 {
     debug("device unmounted");
     device_mounted = false;
+
+#if SUSPEND_READER_WHEN_NO_USB
+    set_readers_running(false);
+#endif
 }
 
 // Invoked when usb bus is suspended
@@ -167,30 +393,215 @@ void cdc_send(char* buf) {
 // USB HID
 //--------------------------------------------------------------------+
 
-bool hid_creature_joystick_report(uint8_t instance, uint8_t report_id,
-                                  int8_t x,  int8_t y, int8_t z,
-                                  int8_t rz, int8_t rx, int8_t ry,
-                                  uint8_t left_dial, uint8_t right_dial,
-                                  button_t buttons) {
-    creature_joystick_report_t report =
-            {
-                    .x       = x,
-                    .y       = y,
-                    .z       = z,
-                    .rz      = rz,
-                    .rx      = rx,
-                    .ry      = ry,
-                    .left_dial = left_dial,
-                    .right_dial = right_dial,
-                    .buttons = buttons
-            };
+/**
+ * The axes keep unsigned values, but the report wants them centered on zero
+ */
+static inline hid_axis_t hid_axis_value(const controller_state *state, const axis *a) {
+    return (hid_axis_t)((int32_t)state->axes[a->index] - HID_AXIS_CENTER);
+}
+
+/**
+ * Fill in a joystick report from a snapshot
+ */
+static void hid_joystick_report_from_state(creature_joystick_report_t *report,
+                                           const controller_state *state,
+                                           button_t buttons) {
+
+    report->x = hid_axis_value(state, &joystick1.x);
+    report->y = hid_axis_value(state, &joystick1.y);
+    report->z = hid_axis_value(state, &joystick1.z);
+    report->rz = hid_axis_value(state, &joystick2.x);
+    report->rx = hid_axis_value(state, &joystick2.y);
+    report->ry = hid_axis_value(state, &joystick2.z);
+    report->left_dial = hid_axis_value(state, &pot1.z);
+    report->right_dial = hid_axis_value(state, &pot2.z);
+    report->buttons = buttons;
+}
+
+#if HID_EXTENDED_REPORT
+
+/**
+ * Fill in the extended report's sequence number, timestamp, and flags. The sequence number is
+ * the one it gets if it's actually sent.
+ */
+static void hid_joystick_report_extend(creature_joystick_report_t *report,
+                                       const controller_state *state,
+                                       uint64_t now) {
+
+    report->sequence = report_sequence;
+    report->timestamp_us = (uint32_t)state->timestamp_us;
+    report->flags = 0;
+
+    if(state->flags & CONTROLLER_STATE_FILTER_SLEEPING) {
+        report->flags |= HID_REPORT_FLAG_FILTER_SLEEPING;
+    }
+    if(state->flags & CONTROLLER_STATE_CLIPPED) {
+        report->flags |= HID_REPORT_FLAG_CLIPPED;
+    }
+    if((last_report_valid && state->frame_number == last_report_frame)
+       || now - state->timestamp_us > 2 * SAMPLE_CLOCK_INTERVAL_US) {
+        report->flags |= HID_REPORT_FLAG_STALE;
+    }
+}
+
+#endif
+
+#if HID_HISTORY_REPORT
+
+/**
+ * The axes in a history sample, in the same order as the joystick report
+ */
+static const axis *const history_axes[HID_HISTORY_AXES] = {
+        &joystick1.x, &joystick1.y, &joystick1.z,
+        &joystick2.x, &joystick2.y, &joystick2.z,
+        &pot1.z, &pot2.z
+};
+
+// Every history axis has to be read in every frame
+#if ADC_SEPARATE_BUSES
+#define HISTORY_SCAN_US     ((HID_HISTORY_AXES / 2) * ADC_DEFAULT_OVERSAMPLE * ADC_SCAN_CONVERSION_US)
+#else
+#define HISTORY_SCAN_US     (HID_HISTORY_AXES * ADC_DEFAULT_OVERSAMPLE * ADC_SCAN_CONVERSION_US)
+#endif
+
+#if HISTORY_SCAN_US > 1000000 / HID_HISTORY_SAMPLE_RATE_HZ
+#error "the history axes can't be read at HID_HISTORY_SAMPLE_RATE_HZ, turn ADC_DEFAULT_OVERSAMPLE down or ADC_SPI_BAUD_RATE up"
+#endif
+
+/**
+ * The top HID_HISTORY_AXIS_BITS of an axis, centered on zero like the joystick report
+ */
+static inline int32_t history_axis_value(const controller_state *state, const axis *a) {
+    return hid_axis_value(state, a) >> (HID_AXIS_BITS - HID_HISTORY_AXIS_BITS);
+}
+
+/**
+ * Pack a frame's axes into a history sample
+ */
+static void history_pack_axes(uint8_t *out, const controller_state *state) {
+
+#if HID_HISTORY_AXIS_BITS == 12
+    for(uint8_t a = 0; a < HID_HISTORY_AXES; a += 2) {
+        uint32_t low = (uint32_t)history_axis_value(state, history_axes[a]) & 0xFFF;
+        uint32_t high = (uint32_t)history_axis_value(state, history_axes[a + 1]) & 0xFFF;
+        *out++ = low & 0xFF;
+        *out++ = (low >> 8) | ((high & 0x0F) << 4);
+        *out++ = high >> 4;
+    }
+#else
+    for(uint8_t a = 0; a < HID_HISTORY_AXES; a++) {
+        uint32_t value = (uint32_t)history_axis_value(state, history_axes[a]);
+        *out++ = value & 0xFF;
+#if HID_HISTORY_AXIS_BITS == 16
+        *out++ = value >> 8;
+#endif
+    }
+#endif
+}
+
+/**
+ * Send the frames the host hasn't seen yet, or the newest ones if there's more than fit. The
+ * ones that don't make it get counted in lost, same as the ones the ring wrote over.
+ */
+static void send_history_report() {
+
+    uint32_t waiting = controller_state_waiting(&history_cursor);
+    if(waiting == 0) {
+        return;
+    }
+
+    uint32_t lost_before = history_cursor.lost;
+    uint32_t skipped = 0;
+
+    controller_state frames[HID_HISTORY_SAMPLES];
+    while(waiting > HID_HISTORY_SAMPLES && controller_state_next(&history_cursor, &frames[0])) {
+        waiting--;
+        skipped++;
+    }
+
+    uint8_t count = 0;
+    while(count < HID_HISTORY_SAMPLES && controller_state_next(&history_cursor, &frames[count])) {
+        count++;
+    }
+    if(count == 0) {
+        return;
+    }
+
+    uint32_t lost = (history_cursor.lost - lost_before) + skipped;
+    uint64_t newest_us = frames[count - 1].timestamp_us;
+
+    creature_history_report_t report;
+    memset(&report, '\0', sizeof(report));
+    report.timestamp_us = (uint32_t)newest_us;
+    report.count = count;
+    report.lost = lost > UINT8_MAX ? UINT8_MAX : (uint8_t)lost;
+
+    for(uint8_t i = 0; i < count; i++) {
 
+        uint64_t age = newest_us - frames[i].timestamp_us;
+        report.samples[i].age_us = age > UINT16_MAX ? UINT16_MAX : (uint16_t)age;
 
-    verbose("instance: %d, report: %d %d %d %d %d %d, buttons: %ul", instance, report.x, report.y, report.z, report.rz, report.rx, report.ry, buttons);
+        history_pack_axes(report.samples[i].axes, &frames[i]);
+    }
+
+    // These frames are gone from the cursor either way, so if it didn't go out they're lost too
+    if(!tud_hid_n_report(JOYSTICK, REPORT_ID_HISTORY, &report, sizeof(report))) {
+        history_samples_lost += lost + count;
+        return;
+    }
 
-    return tud_hid_n_report(instance, report_id, &report, sizeof(report));
+    history_reports_sent++;
+    history_samples_sent += count;
+    history_samples_lost += lost;
 }
 
+#endif
+
+
+/**
+ * Bring reported_buttons up to date from the button events
+ *
+ * Each button only gets to change once per report. If it changes again the rest of the events
+ * wait for the next report, so a tap that's shorter than the polling interval still shows up
+ * on the host as a press and then a release.
+ */
+static void apply_button_events() {
+
+    button_t changed = 0;
+    button_event event;
+    uint64_t now = time_us_64();
+
+    while(button_event_peek(&button_cursor, &event)) {
+
+        if(changed & (1u << event.button)) {
+            break;
+        }
+
+        if(event.pressed) {
+            setButton(&reported_buttons, event.button);
+        }
+        else {
+            clearButton(&reported_buttons, event.button);
+        }
+        changed |= (1u << event.button);
+        latency_stats_record(&button_latency, (uint32_t)(now - event.timestamp_us));
+
+        button_event_pop(&button_cursor);
+    }
+
+    // If we fell that far behind the events can't be trusted, so start over from the buttons
+    if(button_cursor.lost != buttons_lost) {
+        warning("missed %lu button events, resyncing", button_cursor.lost - buttons_lost);
+        buttons_lost = button_cursor.lost;
+
+        reported_buttons = 0;
+        for(uint8_t i = 0; i < MAX_NUMBER_OF_BUTTONS; i++) {
+            if(button_is_pressed(i)) {
+                setButton(&reported_buttons, i);
+            }
+        }
+    }
+}
 
 static void send_hid_report()
 {
@@ -198,48 +609,67 @@ static void send_hid_report()
     // Skip if we're not ready yet
     if ( !tud_hid_ready() ) return;
 
+    verbose("send_hid_report");
 
-#ifdef SUSPEND_READER_WHEN_NO_USB
+    apply_button_events();
 
-    // Skip if the HID isn't ready
-    if ( !tud_hid_n_ready(JOYSTICK) ) {
+    // Every axis from the same frame
+    controller_state state;
+    controller_state_read(&state);
 
-        // Before we go, if the reader is running, stop it.
-        if( eTaskGetState(analog_reader_task_handler) != eSuspended ) {
-            debug("suspending reader task");
-            vTaskSuspend(analog_reader_task_handler);
-            vTaskSuspend(button_reader_task_handler);
-        }
+    creature_joystick_report_t report;
+    hid_joystick_report_from_state(&report, &state, reported_buttons);
 
+    uint64_t now = time_us_64();
+
+#if HID_EXTENDED_REPORT
+    hid_joystick_report_extend(&report, &state, now);
+#endif
+
+    bool changed = !last_report_valid || memcmp(&report, &last_report, HID_REPORT_STATE_SIZE) != 0;
+    bool idle_due = idle_interval_us != 0 && now - last_report_us >= idle_interval_us;
+
+#if HID_HISTORY_REPORT
+    // The axes go out in the history reports, so the joystick report only has to keep up with
+    // the buttons right away, and with the axes every so often. Every poll it doesn't take is history.
+    bool buttons_changed = !last_report_valid || report.buttons != last_report.buttons;
+    bool axes_due = changed && now - last_report_us >= HID_HISTORY_JOYSTICK_MS * 1000;
+    if(!buttons_changed && !axes_due && !idle_due) {
+        reports_suppressed++;
+        send_history_report();
         return;
     }
-
-    // Make sure the reader is running
-    if(eTaskGetState(analog_reader_task_handler) == eSuspended ) {
-        debug("resuming joystick reader");
-        vTaskResume(analog_reader_task_handler);
-        vTaskResume(button_reader_task_handler);
+#elif HID_REPORT_ON_CHANGE
+    // Nothing new, and the host hasn't asked to hear it again yet
+    if(!changed && !idle_due) {
+        reports_suppressed++;
+        return;
     }
-
+#else
+    (void) changed;
+    (void) idle_due;
 #endif
 
-    verbose("send_hid_report");
+    verbose("report: %d %d %d %d %d %d, buttons: %ul", report.x, report.y, report.z, report.rz, report.rx, report.ry, report.buttons);
 
-    hid_creature_joystick_report(
-            JOYSTICK,
-            0x01,
-            joystick1.x.filtered_value + SCHAR_MIN,
-            joystick1.y.filtered_value + SCHAR_MIN,
-            joystick1.z.filtered_value + SCHAR_MIN,
-            joystick2.x.filtered_value + SCHAR_MIN,
-            joystick2.y.filtered_value + SCHAR_MIN,
-            joystick2.z.filtered_value + SCHAR_MIN,
-            pot1.z.filtered_value + SCHAR_MIN,
-            pot2.z.filtered_value + SCHAR_MIN,
-            button_state_mask
-            );
+    if(!tud_hid_n_report(JOYSTICK, REPORT_ID_GAMEPAD, &report, sizeof(report))) {
+        return;
+    }
 
+    last_report = report;
+    last_report_us = now;
+    last_report_valid = true;
     reports_sent++;
+
+#if HID_EXTENDED_REPORT
+    report_sequence++;
+    last_report_frame = state.frame_number;
+#endif
+
+    if(state.timestamp_us != 0) {
+        latency_stats_record(&frame_age, (uint32_t)(now - state.timestamp_us));
+        queued_frame_us = state.timestamp_us;
+    }
 }
 
 // Invoked when sent REPORT successfully to host
@@ -248,6 +678,17 @@ static void send_hid_report()
 void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
 {
     verbose("tud_hid_report_complete_cb: instance: %u, report: %u, len: %u", instance, report[0], len);
+
+    // The host just took it, so this is as close as we get to when its IN token showed up
+    if(queued_frame_us != 0) {
+        latency_stats_record(&in_token_age, (uint32_t)(time_us_64() - queued_frame_us));
+        queued_frame_us = 0;
+    }
+
+#if USB_SOF_SYNC
+    // And now we know which frames it polls in
+    host_poll_phase = last_sof_frame % POLLING_INTERVAL;
+#endif
 }
 
 // Invoked when received GET_REPORT control request
@@ -255,16 +696,41 @@ void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_
 // Return zero will cause the stack to STALL request
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen)
 {
-    // TODO not Implemented
-    (void) instance;
-    (void) report_id;
-    (void) report_type;
-    (void) buffer;
-    (void) reqlen;
-
     debug("get report: %d, %d, %d, %d", instance, report_id, report_type, reqlen);
 
-    return 0;
+    // Only the joystick report can be asked for. The history is only any use as it happens, so
+    // it and anything else gets a STALL.
+    if(report_type != HID_REPORT_TYPE_INPUT || report_id != REPORT_ID_GAMEPAD) {
+        return 0;
+    }
+
+    // Where everything is right now, without touching what the reports have told the host
+    controller_state state;
+    controller_state_read(&state);
+
+    creature_joystick_report_t report;
+    hid_joystick_report_from_state(&report, &state, state.buttons);
+
+#if HID_EXTENDED_REPORT
+    // It doesn't use up a sequence number, since it didn't come in on the interrupt endpoint
+    hid_joystick_report_extend(&report, &state, time_us_64());
+#endif
+
+    uint16_t length = reqlen < sizeof(report) ? reqlen : sizeof(report);
+    memcpy(buffer, &report, length);
+
+    get_reports_answered++;
+    return length;
+}
+
+// Invoked when received SET_IDLE request. idle_rate is in 4ms steps, and 0 means only send
+// a report when something changes.
+bool tud_hid_set_idle_cb(uint8_t instance, uint8_t idle_rate)
+{
+    debug("set idle: %d on instance %d", idle_rate, instance);
+
+    idle_interval_us = (uint32_t)idle_rate * 4000;
+    return true;
 }
 
 // Invoked when received SET_REPORT control request or
@@ -275,12 +741,219 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
 }
 
 
+/**
+ * One line per axis with its noise floor and the activity threshold that came from it, in
+ * axis counts
+ */
+static void cdc_describe_noise(uint8_t itf) {
+
+    char line[LOGGING_MESSAGE_MAX_LENGTH];
+
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+
+        analog_filter *filter = &axis_collection[i]->filter;
+        uint32_t noise = (uint32_t)(analog_filter_get_noise_floor(filter) * 100.0f);
+        uint32_t threshold = (uint32_t)analog_filter_get_activity_threshold(filter);
+
+        snprintf(line, sizeof(line), "axis %u (channel %u): noise %lu.%02lu, threshold %lu\r\n",
+                 i, axis_collection[i]->adc_channel, noise / 100, noise % 100, threshold);
+        tud_cdc_n_write_str(itf, line);
+    }
+}
+
+/**
+ * One line per axis with its calibration, or what's been seen so far if one's going
+ */
+static void cdc_describe_calibration(uint8_t itf) {
+
+    char line[LOGGING_MESSAGE_MAX_LENGTH];
+
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+        calibration_describe_axis(i, line, sizeof(line) - 2);
+        strcat(line, "\r\n");
+        tud_cdc_n_write_str(itf, line);
+    }
+}
+
+/**
+ * One line per axis with the response curve it's using
+ */
+static void cdc_describe_curves(uint8_t itf) {
+
+    char line[LOGGING_MESSAGE_MAX_LENGTH];
+
+    for(uint8_t i = 0; i < number_of_axen; i++) {
+        curve_store_describe_axis(i, line, sizeof(line) - 2);
+        strcat(line, "\r\n");
+        tud_cdc_n_write_str(itf, line);
+    }
+}
+
+/**
+ * One line of latency stats, with a name in front
+ */
+static void cdc_describe_latency(uint8_t itf, const char *name, const latency_stats *stats) {
+
+    char line[LOGGING_MESSAGE_MAX_LENGTH];
+
+    int length = snprintf(line, sizeof(line), "%s: ", name);
+    latency_stats_describe(stats, line + length, sizeof(line) - length - 2);
+    strcat(line, "\r\n");
+    tud_cdc_n_write_str(itf, line);
+}
+
+/**
+ * How busy each core is, then one line per task
+ */
+static void cdc_describe_tasks(uint8_t itf) {
+
+    char line[LOGGING_MESSAGE_MAX_LENGTH];
+
+    UBaseType_t tasks = task_stats_take();
+    if(tasks == 0) {
+        snprintf(line, sizeof(line), "more than %d tasks, can't show them\r\n", TASK_STATS_MAX_TASKS);
+        tud_cdc_n_write_str(itf, line);
+        return;
+    }
+
+    for(uint8_t core = 0; core < configNUMBER_OF_CORES; core++) {
+        task_stats_describe_core(core, line, sizeof(line) - 2);
+        strcat(line, "\r\n");
+        tud_cdc_n_write_str(itf, line);
+    }
+
+    for(UBaseType_t i = 0; i < tasks; i++) {
+        task_stats_describe_task(i, line, sizeof(line) - 2);
+        strcat(line, "\r\n");
+        tud_cdc_n_write_str(itf, line);
+
+        // There's a lot of these, so let them out as they go
+        tud_cdc_n_write_flush(itf);
+    }
+}
+
+/**
+ * Answer a command that came in on CDC 1
+ *
+ *   jitter             - frame timing stats
+ *   jitter reset       - start the frame timing stats over
+ *   noise              - the noise floor and activity threshold of each axis
+ *   buttons            - button scanner and event counts
+ *   latency            - how old the axes and buttons are when a report goes out, and when
+ *                        the host picks it up
+ *   latency reset      - start the latency stats over
+ *   hid                - joystick reports sent and skipped (for a history report too), and
+ *                        the idle interval
+ *   history            - history reports and samples sent, and samples lost
+ *   sof                - how well the sample clock is lined up with the USB frames
+ *   tasks              - how busy each core is, and where each task runs and how much
+ *   tasks reset        - start the CPU numbers over
+ *   calibrate start    - leave the sticks alone, then sweep every axis end to end
+ *   calibrate save     - use what was seen and store it in the EEPROM
+ *   calibrate cancel   - forget what was seen
+ *   calibrate show     - the calibration of each axis
+ *   curves             - the response curve of each axis
+ *
+ * Anything else just gets an OK back.
+ */
+static void cdc_handle_command(uint8_t itf, char* command) {
+
+    char reply[LOGGING_MESSAGE_MAX_LENGTH];
+
+    // Strip off the line ending
+    command[strcspn(command, "\r\n")] = '\0';
+
+    if(strcmp(command, "jitter") == 0) {
+        jitter_histogram_describe(adc_scan_frame_jitter(), reply, sizeof(reply) - 2);
+        strcat(reply, "\r\n");
+    }
+    else if(strcmp(command, "jitter reset") == 0) {
+        adc_scan_reset_frame_jitter();
+        strcpy(reply, "OK\r\n");
+    }
+    else if(strcmp(command, "noise") == 0) {
+        cdc_describe_noise(itf);
+        strcpy(reply, "OK\r\n");
+    }
+    else if(strcmp(command, "buttons") == 0) {
+        snprintf(reply, sizeof(reply), "scanner changes: %lu, events: %lu, early reports: %lu, lost: %lu\r\n",
+                 button_scan_changes(), button_events_written(), button_reports_sent, button_cursor.lost);
+    }
+    else if(strcmp(command, "latency") == 0) {
+        cdc_describe_latency(itf, "frame age", &frame_age);
+        cdc_describe_latency(itf, "in token age", &in_token_age);
+        cdc_describe_latency(itf, "tick to report", &tick_to_report);
+        cdc_describe_latency(itf, "button latency", &button_latency);
+        strcpy(reply, "OK\r\n");
+    }
+    else if(strcmp(command, "latency reset") == 0) {
+        latency_stats_init(&frame_age);
+        latency_stats_init(&button_latency);
+        latency_stats_init(&in_token_age);
+        latency_stats_init(&tick_to_report);
+        strcpy(reply, "OK\r\n");
+    }
+    else if(strcmp(command, "hid") == 0) {
+        snprintf(reply, sizeof(reply), "sent: %lu, suppressed: %lu, get report: %lu, idle: %lums, on change: %s, extended: %s\r\n",
+                 reports_sent, reports_suppressed, get_reports_answered, idle_interval_us / 1000,
+                 HID_REPORT_ON_CHANGE ? "yes" : "no", HID_EXTENDED_REPORT ? "yes" : "no");
+    }
+    else if(strcmp(command, "history") == 0) {
+#if HID_HISTORY_REPORT
+        snprintf(reply, sizeof(reply), "reports: %lu, samples: %lu, lost: %lu, %d per report at %dHz\r\n",
+                 history_reports_sent, history_samples_sent, history_samples_lost,
+                 (int)HID_HISTORY_SAMPLES, HID_HISTORY_SAMPLE_RATE_HZ);
+#else
+        strcpy(reply, "history reports are off\r\n");
+#endif
+    }
+    else if(strcmp(command, "sof") == 0) {
+#if USB_SOF_SYNC
+        snprintf(reply, sizeof(reply), "SOFs: %lu, host polls on frame %% %d == %u, lead: %dus, phase error: %ldus\r\n",
+                 sofs_seen, POLLING_INTERVAL, host_poll_phase, USB_SOF_LEAD_US, sample_clock_phase_error_us());
+#else
+        strcpy(reply, "SOF sync is off\r\n");
+#endif
+    }
+    else if(strcmp(command, "tasks") == 0) {
+        cdc_describe_tasks(itf);
+        strcpy(reply, "OK\r\n");
+    }
+    else if(strcmp(command, "tasks reset") == 0) {
+        task_stats_reset();
+        strcpy(reply, "OK\r\n");
+    }
+    else if(strcmp(command, "calibrate start") == 0) {
+        strcpy(reply, calibration_start() ? "OK\r\n" : "ERROR already calibrating\r\n");
+    }
+    else if(strcmp(command, "calibrate save") == 0) {
+        snprintf(reply, sizeof(reply), "OK %u axes calibrated\r\n", calibration_save());
+    }
+    else if(strcmp(command, "calibrate cancel") == 0) {
+        calibration_cancel();
+        strcpy(reply, "OK\r\n");
+    }
+    else if(strcmp(command, "calibrate show") == 0) {
+        cdc_describe_calibration(itf);
+        strcpy(reply, "OK\r\n");
+    }
+    else if(strcmp(command, "curves") == 0) {
+        cdc_describe_curves(itf);
+        strcpy(reply, "OK\r\n");
+    }
+    else {
+        strcpy(reply, "OK\r\n");
+    }
+
+    tud_cdc_n_write_str(itf, reply);
+    tud_cdc_n_write_flush(itf);
+}
+
 // callback when data is received on a CDC interface
-//  This is taken from the Pi demo, none of this is real to the joystick
 void tud_cdc_rx_cb(uint8_t itf)
 {
     // allocate buffer for the data in the stack
-    uint8_t buf[CFG_TUD_CDC_RX_BUFSIZE];
+    char buf[CFG_TUD_CDC_RX_BUFSIZE + 1];
 
     debug("RX CDC %d", itf);
 
@@ -288,17 +961,14 @@ void tud_cdc_rx_cb(uint8_t itf)
     // | IMPORTANT: also do this for CDC0 because otherwise
     // | you won't be able to print anymore to CDC0
     // | next time this function is called
-    uint32_t count = tud_cdc_n_read(itf, buf, sizeof(buf));
+    uint32_t count = tud_cdc_n_read(itf, buf, CFG_TUD_CDC_RX_BUFSIZE);
 
     // check if the data was received on the second cdc interface
     if (itf == 1) {
         // process the received data
         buf[count] = 0; // null-terminate the string
-        // now echo data back to the console on CDC 0
         debug("Received on CDC 1: %s", buf);
 
-        // and echo back OK on CDC 1
-        tud_cdc_n_write(itf, (uint8_t const *) "OK\r\n", 4);
-        tud_cdc_n_write_flush(itf);
+        cdc_handle_command(itf, buf);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,126 @@
+
+/*
+ * Walks the HID report descriptor at compile time and makes sure the reports it describes
+ * are the same size as the structs we actually send. If someone changes one without the
+ * other, the build stops here instead of the host quietly reading garbage.
+ *
+ * There's no code in here, it's all static_asserts.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tusb.h"
+
+#include "controller-config.h"
+
+#include "usb/hid_report.h"
+#include "usb/usb_descriptors.h"
+
+namespace {
+
+    constexpr uint8_t descriptor[] = {
+            ACW_JOYSTICK_HID_REPORT_DESCRIPTOR
+    };
+
+    // Item types and the tags we care about, from the HID spec (6.2.2)
+    constexpr uint8_t ITEM_MAIN = 0;
+    constexpr uint8_t ITEM_GLOBAL = 1;
+
+    constexpr uint8_t MAIN_INPUT = 8;
+    constexpr uint8_t MAIN_OUTPUT = 9;
+
+    constexpr uint8_t GLOBAL_REPORT_SIZE = 7;
+    constexpr uint8_t GLOBAL_REPORT_ID = 8;
+    constexpr uint8_t GLOBAL_REPORT_COUNT = 9;
+
+    constexpr uint8_t LONG_ITEM = 0xFE;
+
+    /**
+     * Adds up the bits in every main item with this tag in one report. Returns SIZE_MAX if the
+     * items don't end exactly where the descriptor does.
+     */
+    constexpr size_t report_bits(uint8_t report_id, uint8_t main_tag) {
+
+        size_t size = 0;
+        size_t count = 0;
+        uint8_t current_id = 0;
+        size_t bits = 0;
+
+        size_t i = 0;
+        while(i < sizeof(descriptor)) {
+
+            uint8_t prefix = descriptor[i];
+
+            if(prefix == LONG_ITEM) {
+                i += 3 + descriptor[i + 1];
+                continue;
+            }
+
+            size_t data_size = prefix & 0x03;
+            if(data_size == 3) {
+                data_size = 4;
+            }
+
+            uint32_t data = 0;
+            for(size_t b = 0; b < data_size && i + 1 + b < sizeof(descriptor); b++) {
+                data |= (uint32_t)descriptor[i + 1 + b] << (8 * b);
+            }
+
+            uint8_t type = (prefix >> 2) & 0x03;
+            uint8_t tag = prefix >> 4;
+
+            if(type == ITEM_GLOBAL) {
+                if(tag == GLOBAL_REPORT_SIZE) {
+                    size = data;
+                } else if(tag == GLOBAL_REPORT_COUNT) {
+                    count = data;
+                } else if(tag == GLOBAL_REPORT_ID) {
+                    current_id = (uint8_t)data;
+                }
+            }
+            else if(type == ITEM_MAIN && tag == main_tag && current_id == report_id) {
+                bits += size * count;
+            }
+
+            i += 1 + data_size;
+        }
+
+        return i == sizeof(descriptor) ? bits : SIZE_MAX;
+    }
+}
+
+static_assert(report_bits(REPORT_ID_GAMEPAD, MAIN_INPUT) != SIZE_MAX,
+              "the HID report descriptor doesn't parse");
+
+static_assert(report_bits(REPORT_ID_GAMEPAD, MAIN_INPUT) == sizeof(creature_joystick_report_t) * 8,
+              "the HID report descriptor doesn't match creature_joystick_report_t");
+
+static_assert(report_bits(REPORT_ID_GAMEPAD, MAIN_OUTPUT) % 8 == 0,
+              "the LED output report needs to be padded out to a whole byte");
+
+static_assert(sizeof(button_t) * 8 == MAX_NUMBER_OF_BUTTONS,
+              "button_t needs a bit for every button, and no more, or the report won't line up");
+
+static_assert(sizeof(creature_joystick_report_t) + 1 <= CFG_TUD_HID_EP_BUFSIZE,
+              "creature_joystick_report_t and its report ID don't fit in the HID endpoint");
+
+#if HID_HISTORY_REPORT
+
+static_assert(report_bits(REPORT_ID_HISTORY, MAIN_INPUT) == sizeof(creature_history_report_t) * 8,
+              "the HID report descriptor doesn't match creature_history_report_t");
+
+static_assert(sizeof(creature_history_report_t) + 1 <= CFG_TUD_HID_EP_BUFSIZE,
+              "creature_history_report_t and its report ID don't fit in the HID endpoint");
+
+static_assert(HID_HISTORY_SAMPLES > 0,
+              "there's no room in the HID endpoint for even one history sample");
+
+static_assert(sizeof(creature_history_report_t) - sizeof(creature_history_sample_t) * HID_HISTORY_SAMPLES
+                      == HID_HISTORY_HEADER_SIZE,
+              "HID_HISTORY_HEADER_SIZE doesn't match creature_history_report_t");
+
+static_assert(sizeof(creature_history_sample_t) == HID_HISTORY_SAMPLE_SIZE,
+              "HID_HISTORY_SAMPLE_SIZE doesn't match creature_history_sample_t");
+
+#endif
@@ -6,6 +6,7 @@
 #include "controller-config.h"
 #include "tusb.h"
 #include "usb_descriptors.h"
+#include "usb/hid_report.h"
 
 
 // Global variables loaded from EEPROM (set these values before USB init)
@@ -63,7 +64,7 @@ uint8_t const *tud_descriptor_device_cb(void) {
 // HID Report Descriptor
 //--------------------------------------------------------------------+
 uint8_t const desc_hid_report[] = {
-        TUD_HID_REPORT_DESC_ACW_JOYSTICK(HID_REPORT_ID(REPORT_ID_GAMEPAD))
+        ACW_JOYSTICK_HID_REPORT_DESCRIPTOR
 };
 
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t interface) {
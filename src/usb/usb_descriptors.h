@@ -34,13 +34,55 @@ extern "C"
 
 void usb_descriptors_init(void);
 
+/*
+ * The axes are signed, centered on zero. The 8 bit layout is exactly what it's always been.
+ * The wider ones get two bytes each, even at 12 bits, so the report struct doesn't need
+ * bit fields.
+ */
+#if HID_AXIS_BITS == 8
+#define TUD_HID_REPORT_DESC_ACW_AXIS_RANGE \
+    HID_LOGICAL_MIN    ( 0x81                                   ) ,\
+    HID_LOGICAL_MAX    ( 0x7f                                   )
+#define TUD_HID_REPORT_DESC_ACW_AXIS_SIZE \
+    HID_REPORT_SIZE    ( 8                                      )
+#else
+#define TUD_HID_REPORT_DESC_ACW_AXIS_RANGE \
+    HID_LOGICAL_MIN_N  ( -(1 << (HID_AXIS_BITS - 1)), 2         ) ,\
+    HID_LOGICAL_MAX_N  ( (1 << (HID_AXIS_BITS - 1)) - 1, 2      )
+#define TUD_HID_REPORT_DESC_ACW_AXIS_SIZE \
+    HID_REPORT_SIZE    ( 16                                     )
+#endif
+
+/*
+ * The extended report's sequence number, timestamp, and flags, all as plain bytes on the
+ * vendor page. The comma's on the end so it can go away completely when it's off.
+ */
+#if HID_EXTENDED_REPORT
+#define TUD_HID_REPORT_DESC_ACW_EXTENDED \
+    HID_USAGE_PAGE_N   ( HID_USAGE_PAGE_VENDOR, 2               ) ,\
+    HID_LOGICAL_MIN    ( 0x00                                   ) ,\
+    HID_LOGICAL_MAX_N  ( 0xff, 2                                ) ,\
+    HID_REPORT_SIZE    ( 8                                      ) ,\
+    HID_USAGE          ( 0x20                                   ) ,\
+    HID_REPORT_COUNT   ( 1                                      ) ,\
+    HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+    HID_USAGE          ( 0x21                                   ) ,\
+    HID_REPORT_COUNT   ( 4                                      ) ,\
+    HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+    HID_USAGE          ( 0x22                                   ) ,\
+    HID_REPORT_COUNT   ( 1                                      ) ,\
+    HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,
+#else
+#define TUD_HID_REPORT_DESC_ACW_EXTENDED
+#endif
+
 #define TUD_HID_REPORT_DESC_ACW_JOYSTICK(...) \
   HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP     )                 ,\
   HID_USAGE      ( HID_USAGE_DESKTOP_GAMEPAD  )                 ,\
   HID_COLLECTION ( HID_COLLECTION_APPLICATION )                 ,\
     /* Report ID if any */\
     __VA_ARGS__ \
-    /* 8 bit X, Y, Z, Rz, Rx, Ry (min -127, max 127 ) */ \
+    /* X, Y, Z, Rx, Ry, Rz, Dial, Wheel, HID_AXIS_BITS each */ \
     HID_USAGE_PAGE     ( HID_USAGE_PAGE_DESKTOP                 ) ,\
     HID_USAGE          ( HID_USAGE_DESKTOP_X                    ) ,\
     HID_USAGE          ( HID_USAGE_DESKTOP_Y                    ) ,\
@@ -50,20 +92,21 @@ void usb_descriptors_init(void);
     HID_USAGE          ( HID_USAGE_DESKTOP_RZ                   ) ,\
     HID_USAGE          ( HID_USAGE_DESKTOP_DIAL                 ) ,\
     HID_USAGE          ( HID_USAGE_DESKTOP_WHEEL                ) ,\
-    HID_LOGICAL_MIN    ( 0x81                                   ) ,\
-    HID_LOGICAL_MAX    ( 0x7f                                   ) ,\
+    TUD_HID_REPORT_DESC_ACW_AXIS_RANGE                          ,\
     HID_REPORT_COUNT   ( 8                                      ) ,\
-    HID_REPORT_SIZE    ( 8                                      ) ,\
+    TUD_HID_REPORT_DESC_ACW_AXIS_SIZE                           ,\
     HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
-    /* Eight buttons */ \
+    /* A bit for each button, which fills up button_t */ \
     HID_USAGE_PAGE     ( HID_USAGE_PAGE_BUTTON                  ) ,\
     HID_USAGE_MIN      ( 1                                      ) ,\
-    HID_USAGE_MAX      ( 4                                      ) ,\
+    HID_USAGE_MAX      ( MAX_NUMBER_OF_BUTTONS                  ) ,\
     HID_LOGICAL_MIN    ( 0                                      ) ,\
     HID_LOGICAL_MAX    ( 1                                      ) ,\
-    HID_REPORT_COUNT   ( 4                                      ) ,\
-    HID_REPORT_SIZE    ( sizeof(button_t)                       ) ,\
+    HID_REPORT_COUNT   ( MAX_NUMBER_OF_BUTTONS                  ) ,\
+    HID_REPORT_SIZE    ( 1                                      ) ,\
     HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+    /* Sequence number, timestamp, and flags, if they're on */ \
+    TUD_HID_REPORT_DESC_ACW_EXTENDED \
     /* LEDs */                                \
     HID_USAGE_PAGE     ( HID_USAGE_PAGE_LED                     ) ,\
     HID_USAGE          ( 0x17                                   ) ,\
@@ -84,12 +127,43 @@ void usb_descriptors_init(void);
     HID_COLLECTION_END
 
 
+/*
+ * The history report is just bytes on the vendor page, in its own collection so nothing
+ * thinks it's part of the joystick. Its size is whatever creature_history_report_t is.
+ */
+#define TUD_HID_REPORT_DESC_ACW_HISTORY(size, ...) \
+  HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2   )               ,\
+  HID_USAGE        ( 0x01                       )               ,\
+  HID_COLLECTION   ( HID_COLLECTION_APPLICATION )               ,\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    HID_USAGE          ( 0x02                                   ) ,\
+    HID_LOGICAL_MIN    ( 0x00                                   ) ,\
+    HID_LOGICAL_MAX_N  ( 0xff, 2                                ) ,\
+    HID_REPORT_SIZE    ( 8                                      ) ,\
+    HID_REPORT_COUNT   ( size                                   ) ,\
+    HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+  HID_COLLECTION_END
+
 enum {
     REPORT_ID_GAMEPAD = 1,
     REPORT_ID_CDC,
+    REPORT_ID_HISTORY,
     REPORT_ID_COUNT
 };
 
+// This is all of desc_hid_report. It's a macro so usb_descriptor_check.cpp can pick it apart at
+// compile time and make sure it still matches creature_joystick_report_t (and
+// creature_history_report_t).
+#if HID_HISTORY_REPORT
+#define ACW_JOYSTICK_HID_REPORT_DESCRIPTOR \
+    TUD_HID_REPORT_DESC_ACW_JOYSTICK(HID_REPORT_ID(REPORT_ID_GAMEPAD)) ,\
+    TUD_HID_REPORT_DESC_ACW_HISTORY(sizeof(creature_history_report_t), HID_REPORT_ID(REPORT_ID_HISTORY))
+#else
+#define ACW_JOYSTICK_HID_REPORT_DESCRIPTOR \
+    TUD_HID_REPORT_DESC_ACW_JOYSTICK(HID_REPORT_ID(REPORT_ID_GAMEPAD))
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,20 @@
+
+#include "util/crc16.h"
+
+
+/**
+ * CRC-16/CCITT-FALSE, which is what the blocks in the EEPROM are checked with
+ */
+uint16_t crc16(const uint8_t *data, size_t len) {
+
+    uint16_t crc = 0xFFFF;
+
+    for(size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
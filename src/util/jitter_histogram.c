@@ -0,0 +1,88 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include "util/jitter_histogram.h"
+
+// How far below the nominal interval the first bucket starts
+#define JITTER_HISTOGRAM_HALF_SPAN_US   ((JITTER_HISTOGRAM_BUCKETS / 2) * JITTER_HISTOGRAM_BUCKET_US)
+
+
+void jitter_histogram_init(jitter_histogram *h, uint32_t nominal_us) {
+
+    memset(h, '\0', sizeof(jitter_histogram));
+    h->nominal_us = nominal_us;
+    h->min_us = UINT32_MAX;
+}
+
+/**
+ * Record an event that happened at now_us. The first one just sets the starting point.
+ *
+ * No logging in here, this gets called from IRQs.
+ */
+void jitter_histogram_record(jitter_histogram *h, uint64_t now_us) {
+
+    uint64_t last = h->last_us;
+    h->last_us = now_us;
+
+    if(last == 0) {
+        return;
+    }
+
+    uint32_t interval = (uint32_t)(now_us - last);
+
+    if(interval < h->min_us) h->min_us = interval;
+    if(interval > h->max_us) h->max_us = interval;
+
+    int32_t offset = (int32_t)interval - (int32_t)h->nominal_us + JITTER_HISTOGRAM_HALF_SPAN_US;
+    int32_t bucket = offset / JITTER_HISTOGRAM_BUCKET_US;
+
+    if(bucket < 0) bucket = 0;
+    if(bucket >= JITTER_HISTOGRAM_BUCKETS) bucket = JITTER_HISTOGRAM_BUCKETS - 1;
+
+    h->buckets[bucket]++;
+    h->samples++;
+}
+
+/**
+ * The interval that percentile% of the samples are at or under. It's the top edge of the
+ * bucket it falls in, so it's only as good as JITTER_HISTOGRAM_BUCKET_US.
+ */
+uint32_t jitter_histogram_percentile(const jitter_histogram *h, uint8_t percentile) {
+
+    if(h->samples == 0) {
+        return 0;
+    }
+
+    uint32_t wanted = (uint32_t)(((uint64_t)h->samples * percentile + 99) / 100);
+    uint32_t seen = 0;
+
+    for(uint16_t i = 0; i < JITTER_HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if(seen >= wanted) {
+
+            // The last bucket is everything that's too long, so the best we can say is max
+            if(i == JITTER_HISTOGRAM_BUCKETS - 1) {
+                return h->max_us;
+            }
+
+            int32_t top = (int32_t)h->nominal_us - JITTER_HISTOGRAM_HALF_SPAN_US + ((i + 1) * JITTER_HISTOGRAM_BUCKET_US);
+            return top > 0 ? (uint32_t)top : 0;
+        }
+    }
+
+    return h->max_us;
+}
+
+/**
+ * One line summary, good for sending over CDC
+ */
+int jitter_histogram_describe(const jitter_histogram *h, char *buf, size_t length) {
+
+    return snprintf(buf, length, "samples: %lu, nominal: %luus, min: %luus, max: %luus, p99: %luus",
+                    (unsigned long)h->samples,
+                    (unsigned long)h->nominal_us,
+                    (unsigned long)(h->samples ? h->min_us : 0),
+                    (unsigned long)h->max_us,
+                    (unsigned long)jitter_histogram_percentile(h, 99));
+}
@@ -0,0 +1,39 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "controller-config.h"
+
+/**
+ * Histogram of the time between events that are supposed to be evenly spaced
+ *
+ * The buckets are JITTER_HISTOGRAM_BUCKET_US wide and centered on the nominal interval.
+ * Anything that falls off either end lands in the first or last bucket, but min and max
+ * are always exact.
+ *
+ * Recording is safe to do from an IRQ, as long as there's only one thing recording.
+ */
+typedef struct {
+    uint32_t nominal_us;
+    uint64_t last_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t samples;
+    uint32_t buckets[JITTER_HISTOGRAM_BUCKETS];
+} jitter_histogram;
+
+void jitter_histogram_init(jitter_histogram *h, uint32_t nominal_us);
+void jitter_histogram_record(jitter_histogram *h, uint64_t now_us);
+uint32_t jitter_histogram_percentile(const jitter_histogram *h, uint8_t percentile);
+int jitter_histogram_describe(const jitter_histogram *h, char *buf, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,33 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include "util/latency_stats.h"
+
+
+void latency_stats_init(latency_stats *s) {
+
+    memset(s, '\0', sizeof(latency_stats));
+    s->min_us = UINT32_MAX;
+}
+
+void latency_stats_record(latency_stats *s, uint32_t latency_us) {
+
+    if(latency_us < s->min_us) s->min_us = latency_us;
+    if(latency_us > s->max_us) s->max_us = latency_us;
+
+    s->total_us += latency_us;
+    s->samples++;
+}
+
+/**
+ * One line summary, good for sending over CDC
+ */
+int latency_stats_describe(const latency_stats *s, char *buf, size_t length) {
+
+    return snprintf(buf, length, "samples: %lu, min: %luus, mean: %luus, max: %luus",
+                    (unsigned long)s->samples,
+                    (unsigned long)(s->samples ? s->min_us : 0),
+                    (unsigned long)(s->samples ? s->total_us / s->samples : 0),
+                    (unsigned long)s->max_us);
+}
@@ -0,0 +1,31 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Min, mean, and max of how long something took
+ *
+ * Like the jitter histogram, recording is fine from an IRQ as long as there's only one thing
+ * doing it. A reader might see a sample half counted, which is close enough for a stats line.
+ */
+typedef struct {
+    uint32_t samples;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} latency_stats;
+
+void latency_stats_init(latency_stats *s);
+void latency_stats_record(latency_stats *s, uint32_t latency_us);
+int latency_stats_describe(const latency_stats *s, char *buf, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,703 @@
+
+/*
+ * filter-bench
+ *
+ * Runs raw axis traces through the same filter code the controller uses, and reports how
+ * each filter setup behaves, so tuning a creature comes down to numbers instead of watching
+ * the adc-debugger scroll by.
+ *
+ *   filter-bench [-t trace] [-12] [-b band] [-d dump.csv] [-s seed] [stage ...]
+ *
+ * Stages are chained in the order given, just like an axis's pipeline. Leave them off to get
+ * what create_axis() sets up.
+ *
+ *   median3
+ *   oneeuro[:min_cutoff_hz[:beta[:d_cutoff_hz]]]
+ *   kalman[:process_noise[:measurement_noise]]
+ *   responsive[:snap_multiplier[:activity_threshold[:nosleep|adaptive]]]
+ *
+ * The snap multiplier and activity threshold are on the 12 bit scale, like in
+ * controller-config.h, and get scaled up the same way create_axis() does it. "adaptive" turns
+ * on noise adaptation with the bounds from controller-config.h.
+ *
+ * Options:
+ *   -t file   Replay a recorded trace too. One raw value per line, anything else is skipped.
+ *             Can be given more than once.
+ *   -12       Recorded values are 12 bit ADC counts instead of 16 bit axis values
+ *   -b counts Settle band, in 16 bit counts. Defaults to the biggest of one ADC count, 1% of
+ *             the step, and the awake p-p.
+ *   -d file   Write every frame of every trace to a CSV, for plotting
+ *   -s seed   Seed for the synthetic noise
+ *
+ * Everything is in 16 bit axis counts. Once a responsive filter sleeps its output doesn't move
+ * at all, so the jitter would always be 0 and it would look settled the moment it dozed off
+ * anywhere near the target. Each trace is run a second time with sleep turned off on every
+ * stage, and settle, p-p, and rms come from that run. That's what the filter's actually doing,
+ * and sleep just hides whatever's left of it. For each trace it reports:
+ *
+ *   settle    frames from when the input stops moving until the awake output is in the
+ *             settle band for good. "never" if it doesn't get there.
+ *   overshoot how far past the target the output went, as a percent of the step
+ *   p-p, rms  jitter of the awake output while the input is idle (after a warm up)
+ *   track     mean distance from the clean input, or from the raw input for a recording
+ *   fix-flt   furthest apart the fixed point and float responsive filters got on this
+ *             trace, set up the same way. "-" if there's no responsive stage.
+ *   ns/upd    how long one update takes on this machine. Only good for comparing setups
+ *             with each other, the M0+ is a lot slower.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "controller-config.h"
+
+#include "joystick/filter_pipeline.h"
+#include "joystick/responsive_analog_read_filter.h"
+
+#include "filter_math.h"
+
+#define ADC_COUNTS          4096
+#define AXIS_COUNTS         65536
+
+// Same as AXIS_VALUE_SCALE in joystick.c
+#define AXIS_SCALE          (AXIS_COUNTS / ADC_COUNTS)
+
+#define MAX_TRACES          32
+#define MAX_FRAMES          20000
+#define MAX_SPECS           FILTER_PIPELINE_MAX_STAGES
+
+// Synthetic traces sit still this long before they move, and this long after
+#define IDLE_FRAMES         1000
+#define HOLD_FRAMES         1500
+#define RAMP_FRAMES         250
+
+// Ignore the start of a trace while the filters come up from zero
+#define WARM_UP_FRAMES      500
+
+// Keep timing until there's at least this many updates
+#define TIMING_UPDATES      2000000
+
+typedef struct {
+    char name[64];
+    bool recorded;
+    uint32_t length;
+    uint32_t change_start;      // First frame where the clean input moves
+    uint32_t change_end;        // First frame where it's at the final value
+    uint16_t raw[MAX_FRAMES];
+    uint16_t clean[MAX_FRAMES];
+    uint16_t out[MAX_FRAMES];
+    uint16_t awake[MAX_FRAMES];     // Same thing with sleep off
+} trace;
+
+typedef enum {
+    STAGE_MEDIAN3,
+    STAGE_ONE_EURO,
+    STAGE_KALMAN,
+    STAGE_RESPONSIVE
+} stage_kind;
+
+typedef struct {
+    stage_kind kind;
+    float a;
+    float b;
+    float c;
+    bool sleep;
+    bool adaptive;
+} stage_spec;
+
+typedef struct {
+    int32_t settle;             // -1 for never, -2 if there's nothing to settle to
+    float overshoot;
+    uint32_t jitter_pp;
+    float jitter_rms;
+    float track;
+    int32_t fixed_float;        // -1 if there's no responsive stage
+    float ns_per_update;
+} trace_result;
+
+
+static trace *traces[MAX_TRACES];
+static uint8_t number_of_traces = 0;
+
+static stage_spec specs[MAX_SPECS];
+static uint8_t number_of_specs = 0;
+
+static analog_filter_bank bench_bank;
+
+static uint64_t rng_state = 0x2545F4914F6CDD1Dull;
+
+
+static uint64_t xorshift() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/**
+ * Normally distributed noise, Box-Muller style
+ */
+static double gaussian(double sigma) {
+
+    double u1 = ((double)(xorshift() >> 11) + 1.0) / 9007199254740993.0;
+    double u2 = (double)(xorshift() >> 11) / 9007199254740992.0;
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * What the firmware would see for a given position: 12 bit ADC counts, scaled up the same
+ * way decimate_samples() does it
+ */
+static uint16_t sample(double position, double noise_sigma) {
+
+    double adc = (position + gaussian(noise_sigma)) / AXIS_SCALE;
+    long counts = lround(adc);
+
+    if(counts < 0) {
+        counts = 0;
+    }
+    else if(counts > ADC_COUNTS - 1) {
+        counts = ADC_COUNTS - 1;
+    }
+
+    return (uint16_t)((uint32_t)counts * 65535u / (ADC_COUNTS - 1));
+}
+
+static trace* new_trace() {
+
+    if(number_of_traces >= MAX_TRACES) {
+        fprintf(stderr, "can't have more than %d traces\n", MAX_TRACES);
+        exit(1);
+    }
+
+    trace *t = calloc(1, sizeof(trace));
+    if(t == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    traces[number_of_traces++] = t;
+    return t;
+}
+
+/**
+ * Sit at from, move to to over ramp_frames (0 is a step), and then hold
+ */
+static void add_synthetic_trace(const char *name, double from, double to, uint32_t ramp_frames, double noise_sigma) {
+
+    trace *t = new_trace();
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->recorded = false;
+    t->length = IDLE_FRAMES + ramp_frames + HOLD_FRAMES;
+    t->change_start = IDLE_FRAMES;
+    t->change_end = IDLE_FRAMES + ramp_frames;
+
+    for(uint32_t i = 0; i < t->length; i++) {
+
+        double position;
+        if(i < t->change_start) {
+            position = from;
+        }
+        else if(i < t->change_end) {
+            position = from + (to - from) * (double)(i - t->change_start + 1) / ramp_frames;
+        }
+        else {
+            position = to;
+        }
+
+        t->clean[i] = sample(position, 0.0);
+        t->raw[i] = sample(position, noise_sigma);
+    }
+}
+
+static void add_synthetic_traces() {
+
+    // Noise in 16 bit counts. 16 is one ADC count.
+    const double noise_levels[] = {0.0, 8.0, 32.0, 128.0};
+    char name[64];
+
+    for(uint8_t n = 0; n < sizeof(noise_levels) / sizeof(noise_levels[0]); n++) {
+
+        double sigma = noise_levels[n];
+
+        snprintf(name, sizeof(name), "idle (noise %.0f)", sigma);
+        add_synthetic_trace(name, 32768, 32768, 0, sigma);
+
+        snprintf(name, sizeof(name), "small step (noise %.0f)", sigma);
+        add_synthetic_trace(name, 32768, 33792, 0, sigma);
+
+        snprintf(name, sizeof(name), "big step (noise %.0f)", sigma);
+        add_synthetic_trace(name, 8192, 57344, 0, sigma);
+
+        snprintf(name, sizeof(name), "ramp (noise %.0f)", sigma);
+        add_synthetic_trace(name, 8192, 57344, RAMP_FRAMES, sigma);
+    }
+}
+
+static void add_recorded_trace(const char *path, bool adc_counts) {
+
+    FILE *f = fopen(path, "r");
+    if(f == NULL) {
+        fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    trace *t = new_trace();
+    snprintf(t->name, sizeof(t->name), "%s", path);
+    t->recorded = true;
+
+    char line[128];
+    while(t->length < MAX_FRAMES && fgets(line, sizeof(line), f) != NULL) {
+
+        char *end;
+        long value = strtol(line, &end, 10);
+        if(end == line) {
+            continue;
+        }
+
+        if(adc_counts) {
+            value = value * 65535 / (ADC_COUNTS - 1);
+        }
+
+        if(value < 0) {
+            value = 0;
+        }
+        else if(value > AXIS_COUNTS - 1) {
+            value = AXIS_COUNTS - 1;
+        }
+
+        t->raw[t->length] = (uint16_t)value;
+        t->clean[t->length] = (uint16_t)value;
+        t->length++;
+    }
+
+    fclose(f);
+
+    if(t->length <= WARM_UP_FRAMES) {
+        fprintf(stderr, "%s only has %u frames, it needs more than %d\n", path, t->length, WARM_UP_FRAMES);
+        exit(1);
+    }
+
+    // There's no telling where a recording settles, so it's all idle as far as the numbers go
+    t->change_start = t->length;
+    t->change_end = t->length;
+}
+
+static bool parse_spec(const char *text, stage_spec *spec) {
+
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%s", text);
+
+    char *name = strtok(buffer, ":");
+    char *args[3] = {strtok(NULL, ":"), strtok(NULL, ":"), strtok(NULL, ":")};
+
+    if(name == NULL) {
+        return false;
+    }
+
+    memset(spec, '\0', sizeof(stage_spec));
+
+    if(strcmp(name, "median3") == 0) {
+        spec->kind = STAGE_MEDIAN3;
+    }
+    else if(strcmp(name, "oneeuro") == 0) {
+        spec->kind = STAGE_ONE_EURO;
+        spec->a = args[0] ? strtof(args[0], NULL) : ONE_EURO_DEFAULT_MIN_CUTOFF_HZ;
+        spec->b = args[1] ? strtof(args[1], NULL) : ONE_EURO_DEFAULT_BETA;
+        spec->c = args[2] ? strtof(args[2], NULL) : ONE_EURO_DEFAULT_D_CUTOFF_HZ;
+    }
+    else if(strcmp(name, "kalman") == 0) {
+        spec->kind = STAGE_KALMAN;
+        spec->a = args[0] ? strtof(args[0], NULL) : KALMAN_DEFAULT_PROCESS_NOISE;
+        spec->b = args[1] ? strtof(args[1], NULL) : KALMAN_DEFAULT_MEASUREMENT_NOISE;
+    }
+    else if(strcmp(name, "responsive") == 0) {
+        spec->kind = STAGE_RESPONSIVE;
+        spec->a = args[0] ? strtof(args[0], NULL) : (float)ANALOG_READ_FILTER_SNAP_VALUE;
+        spec->b = args[1] ? strtof(args[1], NULL) : (float)ANALOG_FILTER_DEFAULT_ACTIVITY_THRESHOLD;
+        spec->sleep = !(args[2] && strcmp(args[2], "nosleep") == 0);
+        spec->adaptive = args[2] && strcmp(args[2], "adaptive") == 0;
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+static void describe_spec(const stage_spec *spec, char *buffer, size_t length) {
+
+    switch(spec->kind) {
+        case STAGE_MEDIAN3:
+            snprintf(buffer, length, "median3");
+            break;
+        case STAGE_ONE_EURO:
+            snprintf(buffer, length, "oneeuro:%g:%g:%g", spec->a, spec->b, spec->c);
+            break;
+        case STAGE_KALMAN:
+            snprintf(buffer, length, "kalman:%g:%g", spec->a, spec->b);
+            break;
+        case STAGE_RESPONSIVE:
+            snprintf(buffer, length, "responsive:%g:%g%s", spec->a, spec->b,
+                     spec->sleep ? (spec->adaptive ? ":adaptive" : "") : ":nosleep");
+            break;
+    }
+}
+
+/**
+ * A fresh pipeline from the first number_of_stages specs, with its own bank so nothing carries
+ * over between runs. awake turns sleep off on the responsive stage.
+ */
+static void build_pipeline(filter_pipeline *pipeline, uint8_t number_of_stages, bool awake) {
+
+    analog_filter_bank_init(&bench_bank);
+    filter_pipeline_init(pipeline);
+
+    for(uint8_t i = 0; i < number_of_stages; i++) {
+
+        stage_spec *spec = &specs[i];
+
+        switch(spec->kind) {
+            case STAGE_MEDIAN3:
+                filter_pipeline_add_median3(pipeline);
+                break;
+            case STAGE_ONE_EURO:
+                filter_pipeline_add_one_euro(pipeline, spec->a, spec->b, spec->c);
+                break;
+            case STAGE_KALMAN:
+                filter_pipeline_add_kalman(pipeline, spec->a, spec->b);
+                break;
+            case STAGE_RESPONSIVE: {
+                analog_filter filter = analog_filter_bank_add(&bench_bank, spec->sleep && !awake, spec->a / AXIS_SCALE);
+                analog_filter_set_analog_resolution(&filter, AXIS_COUNTS);
+                analog_filter_set_activity_threshold(&filter, spec->b * AXIS_SCALE);
+                if(spec->adaptive) {
+                    analog_filter_enable_noise_adaptation(&filter,
+                                                          (float)(ANALOG_FILTER_MIN_ACTIVITY_THRESHOLD * AXIS_SCALE),
+                                                          (float)(ANALOG_FILTER_MAX_ACTIVITY_THRESHOLD * AXIS_SCALE));
+                }
+                filter_pipeline_add_responsive(pipeline, filter);
+                break;
+            }
+        }
+    }
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void run_trace(trace *t) {
+
+    filter_pipeline pipeline;
+    build_pipeline(&pipeline, number_of_specs, false);
+
+    for(uint32_t i = 0; i < t->length; i++) {
+        t->out[i] = filter_pipeline_update(&pipeline, t->raw[i]);
+    }
+
+    build_pipeline(&pipeline, number_of_specs, true);
+
+    for(uint32_t i = 0; i < t->length; i++) {
+        t->awake[i] = filter_pipeline_update(&pipeline, t->raw[i]);
+    }
+}
+
+/**
+ * Runs whatever's in front of the responsive stage, and then the responsive stage both ways
+ * on what comes out of it
+ */
+static int32_t compare_fixed_float(trace *t) {
+
+    uint8_t stage = 0;
+    while(stage < number_of_specs && specs[stage].kind != STAGE_RESPONSIVE) {
+        stage++;
+    }
+
+    if(stage == number_of_specs) {
+        return -1;
+    }
+
+    static uint16_t in[MAX_FRAMES];
+    filter_pipeline pipeline;
+    build_pipeline(&pipeline, stage, false);
+
+    for(uint32_t i = 0; i < t->length; i++) {
+        in[i] = filter_pipeline_update(&pipeline, t->raw[i]);
+    }
+
+    const stage_spec *spec = &specs[stage];
+    filter_math_settings settings = {
+            .snap_multiplier = spec->a / AXIS_SCALE,
+            .activity_threshold = spec->b * AXIS_SCALE,
+            .resolution = AXIS_COUNTS,
+            .sleep = spec->sleep,
+            .adaptive = spec->adaptive,
+            .adaptive_min = (float)(ANALOG_FILTER_MIN_ACTIVITY_THRESHOLD * AXIS_SCALE),
+            .adaptive_max = (float)(ANALOG_FILTER_MAX_ACTIVITY_THRESHOLD * AXIS_SCALE)
+    };
+
+    return (int32_t)filter_math_compare(&settings, in, t->length, 0).worst;
+}
+
+static float time_trace(trace *t) {
+
+    filter_pipeline pipeline;
+    uint64_t updates = 0;
+    uint64_t elapsed = 0;
+    volatile uint16_t sink = 0;
+
+    while(updates < TIMING_UPDATES) {
+
+        build_pipeline(&pipeline, number_of_specs, false);
+
+        uint64_t start = now_ns();
+        for(uint32_t i = 0; i < t->length; i++) {
+            sink = filter_pipeline_update(&pipeline, t->raw[i]);
+        }
+        elapsed += now_ns() - start;
+        updates += t->length;
+    }
+
+    (void)sink;
+    return (float)elapsed / (float)updates;
+}
+
+static trace_result measure(trace *t, uint32_t band_override) {
+
+    trace_result r;
+    memset(&r, '\0', sizeof(r));
+
+    // Jitter while idle, with sleep off
+    uint32_t idle_end = t->change_start;
+    uint16_t low = UINT16_MAX;
+    uint16_t high = 0;
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    uint32_t n = 0;
+
+    for(uint32_t i = WARM_UP_FRAMES; i < idle_end; i++) {
+        low = t->awake[i] < low ? t->awake[i] : low;
+        high = t->awake[i] > high ? t->awake[i] : high;
+        sum += t->awake[i];
+        sum_squares += (double)t->awake[i] * t->awake[i];
+        n++;
+    }
+
+    if(n > 0) {
+        double mean = sum / n;
+        r.jitter_pp = high - low;
+        r.jitter_rms = (float)sqrt(fmax(sum_squares / n - mean * mean, 0.0));
+    }
+
+    // Tracking error
+    double track = 0.0;
+    for(uint32_t i = WARM_UP_FRAMES; i < t->length; i++) {
+        track += fabs((double)t->out[i] - t->clean[i]);
+    }
+    r.track = (float)(track / (t->length - WARM_UP_FRAMES));
+
+    // Settling and overshoot only mean something if the input went somewhere
+    int32_t from = t->clean[0];
+    int32_t to = t->clean[t->length - 1];
+    int32_t step = to - from;
+
+    if(t->recorded || step == 0) {
+        r.settle = -2;
+        return r;
+    }
+
+    // Anything tighter than the filter's own jitter would never settle
+    int32_t band = (int32_t)band_override;
+    if(band_override == 0) {
+        band = abs(step) / 100;
+        band = band > AXIS_SCALE ? band : AXIS_SCALE;
+        band = band > (int32_t)r.jitter_pp ? band : (int32_t)r.jitter_pp;
+    }
+
+    // Walk back from the end to find the last frame outside the band
+    int32_t last_outside = -1;
+    for(int32_t i = (int32_t)t->length - 1; i >= (int32_t)t->change_start; i--) {
+        if(abs((int32_t)t->awake[i] - to) > band) {
+            last_outside = i;
+            break;
+        }
+    }
+
+    if(last_outside == (int32_t)t->length - 1) {
+        r.settle = -1;
+    }
+    else {
+        int32_t settled_at = last_outside + 1;
+        r.settle = settled_at > (int32_t)t->change_end ? settled_at - (int32_t)t->change_end : 0;
+    }
+
+    int32_t worst = 0;
+    for(uint32_t i = t->change_start; i < t->length; i++) {
+        int32_t past = step > 0 ? (int32_t)t->out[i] - to : to - (int32_t)t->out[i];
+        worst = past > worst ? past : worst;
+    }
+    r.overshoot = 100.0f * (float)worst / (float)abs(step);
+
+    return r;
+}
+
+static void dump(const char *path) {
+
+    FILE *f = fopen(path, "w");
+    if(f == NULL) {
+        fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    fprintf(f, "trace,frame,raw,clean,filtered,awake\n");
+    for(uint8_t j = 0; j < number_of_traces; j++) {
+        trace *t = traces[j];
+        for(uint32_t i = 0; i < t->length; i++) {
+            fprintf(f, "\"%s\",%u,%u,%u,%u,%u\n", t->name, i, t->raw[i], t->clean[i], t->out[i], t->awake[i]);
+        }
+    }
+
+    fclose(f);
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-t trace] [-12] [-b band] [-d dump.csv] [-s seed] [stage ...]\n", program);
+    fprintf(stderr, "stages: median3, oneeuro[:min_cutoff_hz[:beta[:d_cutoff_hz]]], kalman[:q[:r]],\n");
+    fprintf(stderr, "        responsive[:snap_multiplier[:activity_threshold[:nosleep|adaptive]]]\n");
+}
+
+int main(int argc, char **argv) {
+
+    const char *recordings[MAX_TRACES];
+    uint8_t number_of_recordings = 0;
+    bool adc_counts = false;
+    uint32_t band = 0;
+    const char *dump_path = NULL;
+
+    // getopt() doesn't like -12, so it's picked out by hand first
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-12") == 0) {
+            adc_counts = true;
+            argv[i] = "-a";
+        }
+    }
+
+    int option;
+    while((option = getopt(argc, argv, "t:ab:d:s:h")) != -1) {
+        switch(option) {
+            case 't':
+                if(number_of_recordings < MAX_TRACES) {
+                    recordings[number_of_recordings++] = optarg;
+                }
+                break;
+            case 'a':
+                break;
+            case 'b':
+                band = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                dump_path = optarg;
+                break;
+            case 's':
+                rng_state = strtoull(optarg, NULL, 0);
+                if(rng_state == 0) {
+                    rng_state = 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+
+    for(int i = optind; i < argc; i++) {
+        if(number_of_specs >= MAX_SPECS) {
+            fprintf(stderr, "an axis can't have more than %d stages\n", MAX_SPECS);
+            return 1;
+        }
+        if(!parse_spec(argv[i], &specs[number_of_specs])) {
+            fprintf(stderr, "don't know what the stage \"%s\" is\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        number_of_specs++;
+    }
+
+    // Same as create_axis()
+    if(number_of_specs == 0) {
+        parse_spec("responsive", &specs[number_of_specs++]);
+    }
+
+    add_synthetic_traces();
+    for(uint8_t i = 0; i < number_of_recordings; i++) {
+        add_recorded_trace(recordings[i], adc_counts);
+    }
+
+    printf("pipeline:");
+    for(uint8_t i = 0; i < number_of_specs; i++) {
+        char description[64];
+        describe_spec(&specs[i], description, sizeof(description));
+        printf(" %s", description);
+    }
+    printf("\n%s math, %d Hz frames\n\n", ANALOG_FILTER_FIXED_POINT ? "fixed point" : "float", ADC_FRAME_RATE_HZ);
+
+    printf("%-28s %8s %10s %8s %8s %8s %8s %8s\n",
+           "trace", "settle", "overshoot", "p-p", "rms", "track", "fix-flt", "ns/upd");
+
+    for(uint8_t i = 0; i < number_of_traces; i++) {
+
+        trace *t = traces[i];
+        run_trace(t);
+
+        trace_result r = measure(t, band);
+        r.fixed_float = compare_fixed_float(t);
+        r.ns_per_update = time_trace(t);
+
+        char settle[16];
+        char overshoot[16];
+        char fixed_float[16];
+        if(r.settle == -2) {
+            snprintf(settle, sizeof(settle), "-");
+            snprintf(overshoot, sizeof(overshoot), "-");
+        }
+        else {
+            if(r.settle == -1) {
+                snprintf(settle, sizeof(settle), "never");
+            }
+            else {
+                snprintf(settle, sizeof(settle), "%d", r.settle);
+            }
+            snprintf(overshoot, sizeof(overshoot), "%.1f%%", r.overshoot);
+        }
+
+        if(r.fixed_float < 0) {
+            snprintf(fixed_float, sizeof(fixed_float), "-");
+        }
+        else {
+            snprintf(fixed_float, sizeof(fixed_float), "%d", r.fixed_float);
+        }
+
+        printf("%-28s %8s %10s %8u %8.1f %8.1f %8s %8.1f\n",
+               t->name, settle, overshoot, r.jitter_pp, r.jitter_rms, r.track, fixed_float, r.ns_per_update);
+    }
+
+    if(dump_path != NULL) {
+        dump(dump_path);
+    }
+
+    for(uint8_t i = 0; i < number_of_traces; i++) {
+        free(traces[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+
+/*
+ * filter-equivalence
+ *
+ * Runs the same traces through the float and fixed point versions of the responsive filter
+ * and fails if they get further apart than the limits below. ctest runs it, or run it by hand
+ * to see every setup:
+ *
+ *   filter-equivalence [-v]
+ *
+ * Everything's in 16 bit axis counts, with the filter set up the way create_axis() does it.
+ * The traces are steps, ramps, and a slow sine, each at a few noise levels, with sleep off,
+ * on, and with noise adaptation.
+ *
+ * With sleep off the two have to stay within AWAKE_MAX_DEVIATION on every frame. That's the
+ * actual math.
+ *
+ * With sleep on they can't be held to that. On a slow move the filter naps, wakes up once the
+ * error EMA crosses the activity threshold, jumps, and naps again. If the two wake a frame
+ * apart, each one is holding a different stair step for a frame, and that can be as much as
+ * the threshold. With noise adaptation they can also fold different stretches into their noise
+ * floors, so their thresholds drift apart a little too. So while sleeping they have to stay within the activity threshold (the
+ * highest it can adapt to), and be within AWAKE_MAX_DEVIATION on all but
+ * SLEEPING_MAX_OVER_PERCENT of the frames.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "controller-config.h"
+
+#include "joystick/responsive_analog_read_filter.h"
+
+#include "filter_math.h"
+
+#define ADC_COUNTS          4096
+#define AXIS_COUNTS         65536
+
+// Same as AXIS_VALUE_SCALE in joystick.c
+#define AXIS_SCALE          (AXIS_COUNTS / ADC_COUNTS)
+
+#define TRACE_FRAMES        6000
+
+// One ADC count. The fixed point version truncates everywhere the float one does.
+#define AWAKE_MAX_DEVIATION         (1 * AXIS_SCALE)
+
+#define SLEEPING_MAX_OVER_PERCENT   5.0
+
+static uint64_t rng_state = 0x2545F4914F6CDD1Dull;
+
+
+static uint64_t xorshift() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double gaussian(double sigma) {
+
+    double u1 = ((double)(xorshift() >> 11) + 1.0) / 9007199254740993.0;
+    double u2 = (double)(xorshift() >> 11) / 9007199254740992.0;
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * 12 bit ADC counts scaled up to 16 bits, the same as the bench
+ */
+static uint16_t sample(double position, double noise_sigma) {
+
+    long counts = lround((position + gaussian(noise_sigma)) / AXIS_SCALE);
+
+    if(counts < 0) {
+        counts = 0;
+    }
+    else if(counts > ADC_COUNTS - 1) {
+        counts = ADC_COUNTS - 1;
+    }
+
+    return (uint16_t)((uint32_t)counts * 65535u / (ADC_COUNTS - 1));
+}
+
+typedef enum {
+    SHAPE_STEPS,
+    SHAPE_RAMPS,
+    SHAPE_SINE
+} shape;
+
+static const char *shape_names[] = {"steps", "ramps", "sine"};
+
+static void make_trace(uint16_t *trace, shape kind, double noise_sigma) {
+
+    for(uint32_t i = 0; i < TRACE_FRAMES; i++) {
+
+        double position;
+        switch(kind) {
+            case SHAPE_STEPS:
+                // Big and small steps, and right out to both ends
+                position = (const double[]){32768, 33792, 8192, 57344, 0, 65535}[(i / 1000) % 6];
+                break;
+            case SHAPE_RAMPS:
+                position = (i % 1000) < 500 ? 8192 + 96.0 * (i % 1000) : 56192 - 96.0 * (i % 1000 - 500);
+                break;
+            default:
+                position = 32768 + 30000 * sin(2.0 * M_PI * i / 1500.0);
+                break;
+        }
+
+        trace[i] = sample(position, noise_sigma);
+    }
+}
+
+int main(int argc, char **argv) {
+
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    const float snap_values[] = {0.01f, 0.05f, (float)ANALOG_READ_FILTER_SNAP_VALUE, 1.0f};
+    const double noise_levels[] = {0.0, 8.0, 32.0, 128.0};
+
+    // nosleep, sleep, adaptive
+    const uint8_t sleep_modes = 3;
+
+    static uint16_t trace[TRACE_FRAMES];
+    uint32_t worst_awake = 0;
+    uint32_t worst_sleeping = 0;
+    uint32_t runs = 0;
+    uint32_t failures = 0;
+
+    for(uint8_t s = 0; s < sizeof(snap_values) / sizeof(snap_values[0]); s++) {
+        for(uint8_t mode = 0; mode < sleep_modes; mode++) {
+            for(uint8_t k = SHAPE_STEPS; k <= SHAPE_SINE; k++) {
+                for(uint8_t n = 0; n < sizeof(noise_levels) / sizeof(noise_levels[0]); n++) {
+
+                    make_trace(trace, (shape)k, noise_levels[n]);
+
+                    filter_math_settings settings = {
+                            .snap_multiplier = snap_values[s] / AXIS_SCALE,
+                            .activity_threshold = (float)(ANALOG_FILTER_DEFAULT_ACTIVITY_THRESHOLD * AXIS_SCALE),
+                            .resolution = AXIS_COUNTS,
+                            .sleep = mode > 0,
+                            .adaptive = mode == 2,
+                            .adaptive_min = (float)(ANALOG_FILTER_MIN_ACTIVITY_THRESHOLD * AXIS_SCALE),
+                            .adaptive_max = (float)(ANALOG_FILTER_MAX_ACTIVITY_THRESHOLD * AXIS_SCALE)
+                    };
+
+                    filter_math_deviation d = filter_math_compare(&settings, trace, TRACE_FRAMES,
+                                                                  AWAKE_MAX_DEVIATION);
+                    double over_percent = 100.0 * d.over / TRACE_FRAMES;
+
+                    bool failed;
+                    if(!settings.sleep) {
+                        failed = d.worst > AWAKE_MAX_DEVIATION;
+                    }
+                    else {
+                        float threshold = settings.adaptive ? settings.adaptive_max : settings.activity_threshold;
+                        failed = d.worst > (uint32_t)threshold || over_percent > SLEEPING_MAX_OVER_PERCENT;
+                    }
+
+                    if(verbose || failed) {
+                        printf("%s snap %.2f %-8s %-5s noise %3.0f: worst %u, %.2f%% of frames over %d\n",
+                               failed ? "FAIL" : "    ",
+                               snap_values[s], (const char *[]){"nosleep", "sleep", "adaptive"}[mode],
+                               shape_names[k], noise_levels[n], d.worst, over_percent, AWAKE_MAX_DEVIATION);
+                    }
+
+                    if(!settings.sleep) {
+                        worst_awake = d.worst > worst_awake ? d.worst : worst_awake;
+                    }
+                    else {
+                        worst_sleeping = d.worst > worst_sleeping ? d.worst : worst_sleeping;
+                    }
+                    failures += failed ? 1 : 0;
+                    runs++;
+                }
+            }
+        }
+    }
+
+    printf("%u runs, worst deviation %u counts awake (limit %d), %u with sleep, %u failed\n",
+           runs, worst_awake, AWAKE_MAX_DEVIATION, worst_sleeping, failures);
+    return failures == 0 ? 0 : 1;
+}
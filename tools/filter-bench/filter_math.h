@@ -0,0 +1,48 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The responsive filter built both ways, float and fixed point, in the same program
+ *
+ * The firmware picks one with ANALOG_FILTER_FIXED_POINT. filter_math_float.c and
+ * filter_math_fixed.c each build their own copy of the filter's sources with it set their
+ * way, and rename everything in it so the two copies (and the one the bench's pipelines use)
+ * don't clash. This is all they let out.
+ */
+
+typedef struct {
+    float snap_multiplier;          // Same as analog_filter_bank_add() takes
+    float activity_threshold;       // Counts, at resolution
+    uint32_t resolution;
+    bool sleep;
+    bool adaptive;                  // Noise adaptation between adaptive_min and adaptive_max
+    float adaptive_min;
+    float adaptive_max;
+} filter_math_settings;
+
+typedef struct {
+    uint32_t worst;                 // Furthest apart the two got, in counts
+    uint32_t over;                  // Frames where they were more than the tolerance apart
+} filter_math_deviation;
+
+// Runs a whole trace through one fresh filter
+void filter_math_float_run(const filter_math_settings *settings, const uint16_t *in, uint16_t *out, uint32_t length);
+void filter_math_fixed_run(const filter_math_settings *settings, const uint16_t *in, uint16_t *out, uint32_t length);
+
+/**
+ * Runs a trace through both and sees how far apart they got
+ */
+filter_math_deviation filter_math_compare(const filter_math_settings *settings, const uint16_t *in, uint32_t length,
+                                          uint32_t tolerance);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,39 @@
+
+/*
+ * The responsive filter with fixed point math, whatever controller-config.h says. See
+ * filter_math.h. This is also where filter_math_compare() lives.
+ */
+
+#include <stdlib.h>
+
+#include "controller-config.h"
+
+#undef ANALOG_FILTER_FIXED_POINT
+#define ANALOG_FILTER_FIXED_POINT   1
+#define FILTER_MATH_PREFIX          filter_math_fixed_
+
+#include "filter_math_variant.h"
+
+filter_math_deviation filter_math_compare(const filter_math_settings *settings, const uint16_t *in, uint32_t length,
+                                          uint32_t tolerance) {
+
+    uint16_t *float_out = malloc(length * sizeof(uint16_t));
+    uint16_t *fixed_out = malloc(length * sizeof(uint16_t));
+    if(float_out == NULL || fixed_out == NULL) {
+        abort();
+    }
+
+    filter_math_float_run(settings, in, float_out, length);
+    filter_math_fixed_run(settings, in, fixed_out, length);
+
+    filter_math_deviation result = {0, 0};
+    for(uint32_t i = 0; i < length; i++) {
+        uint32_t deviation = (uint32_t)abs((int32_t)float_out[i] - (int32_t)fixed_out[i]);
+        result.worst = deviation > result.worst ? deviation : result.worst;
+        result.over += deviation > tolerance ? 1 : 0;
+    }
+
+    free(float_out);
+    free(fixed_out);
+    return result;
+}
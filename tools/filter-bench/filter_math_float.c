@@ -0,0 +1,12 @@
+
+/*
+ * The responsive filter with float math, whatever controller-config.h says. See filter_math.h.
+ */
+
+#include "controller-config.h"
+
+#undef ANALOG_FILTER_FIXED_POINT
+#define ANALOG_FILTER_FIXED_POINT   0
+#define FILTER_MATH_PREFIX          filter_math_float_
+
+#include "filter_math_variant.h"
@@ -0,0 +1,63 @@
+
+/*
+ * Builds a private, renamed copy of the responsive filter. Only filter_math_float.c and
+ * filter_math_fixed.c include this, after setting ANALOG_FILTER_FIXED_POINT their way and
+ * FILTER_MATH_PREFIX to what to stick on the front of every name.
+ */
+
+#include "controller-config.h"
+
+#include "filter_math.h"
+
+#define FILTER_MATH_PASTE(prefix, name)     prefix##name
+#define FILTER_MATH_RENAME(prefix, name)    FILTER_MATH_PASTE(prefix, name)
+
+#define analog_filter_default_bank              FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_default_bank)
+#define analog_filter_bank_init                 FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_bank_init)
+#define analog_filter_bank_add                  FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_bank_add)
+#define analog_filter_bank_update               FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_bank_update)
+#define create_analog_filter                    FILTER_MATH_RENAME(FILTER_MATH_PREFIX, create_analog_filter)
+#define analog_filter_get_raw_value             FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_get_raw_value)
+#define analog_filter_get_value                 FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_get_value)
+#define analog_filter_has_changed               FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_has_changed)
+#define analog_filter_is_sleeping               FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_is_sleeping)
+#define analog_filter_set_input                 FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_set_input)
+#define analog_filter_update                    FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_update)
+#define analog_filter_set_snap_multiplier       FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_set_snap_multiplier)
+#define analog_filter_enable_sleep              FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_enable_sleep)
+#define analog_filter_disable_sleep             FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_disable_sleep)
+#define analog_filter_enable_edge_snap          FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_enable_edge_snap)
+#define analog_filter_disable_edge_snap         FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_disable_edge_snap)
+#define analog_filter_set_activity_threshold    FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_set_activity_threshold)
+#define analog_filter_set_analog_resolution     FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_set_analog_resolution)
+#define analog_filter_get_activity_threshold    FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_get_activity_threshold)
+#define analog_filter_enable_noise_adaptation   FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_enable_noise_adaptation)
+#define analog_filter_disable_noise_adaptation  FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_disable_noise_adaptation)
+#define analog_filter_get_noise_floor           FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_get_noise_floor)
+#define analog_filter_track_noise               FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_track_noise)
+#define analog_filter_get_responsive_value      FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_get_responsive_value)
+#define analog_filter_snap_curve                FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_snap_curve)
+#define analog_filter_snap_curve_q16            FILTER_MATH_RENAME(FILTER_MATH_PREFIX, analog_filter_snap_curve_q16)
+
+#include "joystick/responsive_analog_read_filter.c"
+#include "joystick/responsive_analog_read_filter_fixed.c"
+
+void FILTER_MATH_RENAME(FILTER_MATH_PREFIX, run)(const filter_math_settings *settings,
+                                                 const uint16_t *in, uint16_t *out, uint32_t length) {
+
+    static analog_filter_bank bank;
+
+    analog_filter_bank_init(&bank);
+    analog_filter filter = analog_filter_bank_add(&bank, settings->sleep, settings->snap_multiplier);
+    analog_filter_set_analog_resolution(&filter, settings->resolution);
+    analog_filter_set_activity_threshold(&filter, settings->activity_threshold);
+    if(settings->adaptive) {
+        analog_filter_enable_noise_adaptation(&filter, settings->adaptive_min, settings->adaptive_max);
+    }
+
+    for(uint32_t i = 0; i < length; i++) {
+        analog_filter_set_input(&filter, in[i]);
+        analog_filter_bank_update(&bank);
+        out[i] = analog_filter_get_value(&filter);
+    }
+}
@@ -0,0 +1,36 @@
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "logging/logging.h"
+
+static void log_to_stderr(const char *level, const char *message, va_list args) {
+    fprintf(stderr, "[%s] ", level);
+    vfprintf(stderr, message, args);
+    fprintf(stderr, "\n");
+}
+
+void verbose(const char *message, ...) { (void)message; }
+void debug(const char *message, ...) { (void)message; }
+void info(const char *message, ...) { (void)message; }
+
+void warning(const char *message, ...) {
+    va_list args;
+    va_start(args, message);
+    log_to_stderr("W", message, args);
+    va_end(args);
+}
+
+void error(const char *message, ...) {
+    va_list args;
+    va_start(args, message);
+    log_to_stderr("E", message, args);
+    va_end(args);
+}
+
+void fatal(const char *message, ...) {
+    va_list args;
+    va_start(args, message);
+    log_to_stderr("F", message, args);
+    va_end(args);
+}
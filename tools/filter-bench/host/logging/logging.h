@@ -0,0 +1,23 @@
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Stands in for the firmware's logger, which needs FreeRTOS. Warnings and worse go to stderr,
+ * the rest is dropped so it doesn't get in the way of the numbers.
+ */
+
+void verbose(const char *message, ...);
+void debug(const char *message, ...);
+void info(const char *message, ...);
+void warning(const char *message, ...);
+void error(const char *message, ...);
+void fatal(const char *message, ...);
+
+#ifdef __cplusplus
+}
+#endif
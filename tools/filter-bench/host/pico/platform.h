@@ -0,0 +1,11 @@
+
+#pragma once
+
+/*
+ * Just enough of the SDK's platform.h for the filter code to build on a desktop
+ */
+
+#define __not_in_flash_func(func_name)  func_name
+#define __not_in_flash(group)
+#define __force_inline                  inline __attribute__((always_inline))
+#define __unused                        __attribute__((unused))
@@ -0,0 +1,166 @@
+
+/*
+ * response-curve-check
+ *
+ * Compiles a handful of response curves the same way the firmware does when the config loads,
+ * and checks the tables that come out. ctest runs it, or run it by hand:
+ *
+ *   response-curve-check [-v]
+ *
+ * Every curve has to:
+ *
+ *   - go from 0 at the bottom to full scale at the top
+ *   - never go down as the input goes up, as long as its points don't
+ *   - sit on the middle everywhere inside its center deadzone (or wherever its points put
+ *     the middle)
+ *   - sit on the ends everywhere inside its edge deadzones
+ *
+ * A table entry covers 2^RESPONSE_CURVE_INDEX_SHIFT inputs, so the deadzones are only checked
+ * one entry in from where they end.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "controller-config.h"
+
+// The controller only has room for a few tables, and this needs one per curve. The pool's
+// private, so it gets its own copy of the curve code with a bigger one.
+#undef RESPONSE_CURVE_MAX_TABLES
+#define RESPONSE_CURVE_MAX_TABLES   16
+
+#include "joystick/response_curve.c"
+
+#define AXIS_MAX        65535
+#define AXIS_MIDDLE     32768
+
+// One table entry's worth of input
+#define ENTRY_WIDTH     (1 << RESPONSE_CURVE_INDEX_SHIFT)
+
+typedef struct {
+    const char *name;
+    response_curve curve;
+    bool expect_table;
+} curve_case;
+
+static bool show_all = false;
+
+static uint32_t check_curve(const curve_case *c) {
+
+    const uint16_t *table;
+    uint32_t failures = 0;
+
+    if(!response_curve_compile(&c->curve, &table)) {
+        printf("FAIL %s: didn't compile\n", c->name);
+        return 1;
+    }
+
+    if((table != NULL) != c->expect_table) {
+        printf("FAIL %s: %s a table\n", c->name, table == NULL ? "didn't get" : "got");
+        failures++;
+    }
+
+    uint16_t bottom = response_curve_apply(table, 0);
+    uint16_t top = response_curve_apply(table, AXIS_MAX);
+    if(bottom != 0 || top != AXIS_MAX) {
+        printf("FAIL %s: goes from %u to %u\n", c->name, bottom, top);
+        failures++;
+    }
+
+    uint16_t last = 0;
+    for(uint32_t v = 0; v <= AXIS_MAX; v++) {
+        uint16_t out = response_curve_apply(table, (uint16_t)v);
+        if(out < last) {
+            printf("FAIL %s: goes down from %u to %u at %u\n", c->name, last, out, v);
+            failures++;
+            break;
+        }
+        last = out;
+    }
+
+    // Points can move the middle, but the deadzone still has to be flat
+    uint16_t middle = c->curve.number_of_points >= 2 ? response_curve_apply(table, AXIS_MIDDLE) : AXIS_MIDDLE;
+
+    if(c->curve.center_deadzone > ENTRY_WIDTH) {
+        uint32_t from = AXIS_MIDDLE - c->curve.center_deadzone + ENTRY_WIDTH;
+        uint32_t to = AXIS_MIDDLE + c->curve.center_deadzone - ENTRY_WIDTH;
+        for(uint32_t v = from; v <= to; v++) {
+            uint16_t out = response_curve_apply(table, (uint16_t)v);
+            if(out != middle) {
+                printf("FAIL %s: %u is in the center deadzone but came out %u\n", c->name, v, out);
+                failures++;
+                break;
+            }
+        }
+    }
+
+    for(uint32_t v = 0; v + ENTRY_WIDTH <= c->curve.low_deadzone; v++) {
+        uint16_t out = response_curve_apply(table, (uint16_t)v);
+        if(out != 0) {
+            printf("FAIL %s: %u is in the low deadzone but came out %u\n", c->name, v, out);
+            failures++;
+            break;
+        }
+    }
+
+    for(uint32_t v = AXIS_MAX; v + c->curve.high_deadzone >= AXIS_MAX + ENTRY_WIDTH; v--) {
+        uint16_t out = response_curve_apply(table, (uint16_t)v);
+        if(out != AXIS_MAX) {
+            printf("FAIL %s: %u is in the high deadzone but came out %u\n", c->name, v, out);
+            failures++;
+            break;
+        }
+    }
+
+    if(show_all) {
+        printf("%s %s: quarter %u, middle %u, three quarters %u\n", failures ? "FAIL" : "    ", c->name,
+               response_curve_apply(table, AXIS_MAX / 4), response_curve_apply(table, AXIS_MIDDLE),
+               response_curve_apply(table, AXIS_MAX / 4 * 3));
+    }
+
+    return failures;
+}
+
+int main(int argc, char **argv) {
+
+    show_all = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    const curve_case cases[] = {
+            {"straight", {0}, false},
+            {"center deadzone", {.center_deadzone = 2048}, true},
+            {"big center deadzone", {.center_deadzone = 16384}, true},
+            {"edge deadzones", {.low_deadzone = 1000, .high_deadzone = 3000}, true},
+            {"expo 50", {.expo = 50}, true},
+            {"expo 100 with deadzones", {.center_deadzone = 1024, .low_deadzone = 512, .high_deadzone = 512, .expo = 100}, true},
+            {"points", {.number_of_points = 3, .points = {{0, 0}, {32768, 16384}, {65535, 65535}}}, true},
+            {"points and deadzone", {.center_deadzone = 4096, .number_of_points = 4,
+                                     .points = {{0, 0}, {16384, 8192}, {49152, 57344}, {65535, 65535}}}, true},
+            {"same as center deadzone", {.center_deadzone = 2048}, true},
+    };
+    const uint8_t number_of_cases = sizeof(cases) / sizeof(cases[0]);
+
+    uint32_t failures = 0;
+    for(uint8_t i = 0; i < number_of_cases; i++) {
+        failures += check_curve(&cases[i]);
+    }
+
+    // The last one's the same as the second, so it should've shared instead of taking a table
+    if(response_curve_tables_in_use() != number_of_cases - 2) {
+        printf("FAIL built %u tables, should've been %u\n", response_curve_tables_in_use(), number_of_cases - 2);
+        failures++;
+    }
+
+    // A bad curve doesn't get a table, it gets a straight line
+    const uint16_t *table = (const uint16_t *)1;
+    response_curve bad = {.expo = 101};
+    if(response_curve_compile(&bad, &table) || table != NULL) {
+        printf("FAIL a curve with 101%% expo compiled\n");
+        failures++;
+    }
+
+    printf("%u curves, %u failed\n", number_of_cases, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,437 @@
+
+/*
+ * hid-latency
+ *
+ * Records the controller's extended joystick reports (HID_EXTENDED_REPORT) off a Linux hidraw
+ * device, or reads back a capture of them, and works out how well they're making it to the
+ * host. It's meant for chasing down latency problems on a real setup, not on the bench.
+ *
+ *   hid-latency -r /dev/hidrawN [-n reports] [-w capture.txt]
+ *   hid-latency capture.txt
+ *
+ * Recording stops after -n reports, or on ^C, and then the numbers come out the same as they
+ * would for a capture.
+ *
+ * A capture is one report per line: when the host got it in microseconds, then the report's
+ * bytes in hex with the report ID first. Anything else is skipped, so the other reports (the
+ * history report, say) can stay in.
+ *
+ * It reports:
+ *
+ *   dropped   gaps in the sequence numbers, and how much that is of everything that was sent
+ *   repeated  reports with the same sequence number as the one before
+ *   host      time between reports arriving on the host
+ *   frames    time between the frames in those reports, on the controller. The spread of
+ *             these two is the jitter.
+ *   age       how much longer each report took to show up than the quickest one did. The
+ *             controller and the host don't share a clock, so the quickest one counts as zero,
+ *             after taking out the drift between the two clocks.
+ *   flags     how many reports had each flag
+ *
+ * The times on the host are when this read the report, so a busy machine adds to them.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "controller-config.h"
+
+#include "usb/hid_report.h"
+#include "usb/usb_descriptors.h"
+
+#if HID_EXTENDED_REPORT
+
+// Room for a report and its ID, plus anything bigger that comes along on the same device
+#define MAX_REPORT_BYTES    CFG_TUD_HID_EP_BUFSIZE
+
+typedef struct {
+    uint64_t host_us;
+    uint8_t sequence;
+    uint32_t timestamp_us;
+    uint8_t flags;
+} sample;
+
+typedef struct {
+    uint32_t count;
+    double mean;
+    double stdev;
+    double min;
+    double p50;
+    double p99;
+    double max;
+} summary;
+
+
+static sample *samples = NULL;
+static uint32_t number_of_samples = 0;
+static uint32_t samples_room = 0;
+static uint32_t other_reports = 0;
+
+static volatile sig_atomic_t stop = 0;
+
+
+static void on_interrupt(int signal) {
+    (void) signal;
+    stop = 1;
+}
+
+static uint64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/**
+ * Keep a report if it's a joystick report, and count it if it's something else
+ */
+static void add_report(uint64_t host_us, const uint8_t *bytes, size_t length) {
+
+    if(length < 1 + sizeof(creature_joystick_report_t) || bytes[0] != REPORT_ID_GAMEPAD) {
+        other_reports++;
+        return;
+    }
+
+    creature_joystick_report_t report;
+    memcpy(&report, bytes + 1, sizeof(report));
+
+    if(number_of_samples == samples_room) {
+        samples_room = samples_room == 0 ? 65536 : samples_room * 2;
+        samples = realloc(samples, samples_room * sizeof(sample));
+        if(samples == NULL) {
+            fprintf(stderr, "out of memory after %u reports\n", number_of_samples);
+            exit(1);
+        }
+    }
+
+    sample *s = &samples[number_of_samples++];
+    s->host_us = host_us;
+    s->sequence = report.sequence;
+    s->timestamp_us = report.timestamp_us;
+    s->flags = report.flags;
+}
+
+static void write_report(FILE *f, uint64_t host_us, const uint8_t *bytes, size_t length) {
+
+    fprintf(f, "%llu", (unsigned long long)host_us);
+    for(size_t i = 0; i < length; i++) {
+        fprintf(f, " %02x", bytes[i]);
+    }
+    fprintf(f, "\n");
+}
+
+/**
+ * Read reports straight off the controller until there's enough of them, or ^C
+ */
+static void record(const char *device, uint32_t limit, const char *capture_path) {
+
+    int fd = open(device, O_RDONLY);
+    if(fd < 0) {
+        fprintf(stderr, "can't open %s: %s\n", device, strerror(errno));
+        exit(1);
+    }
+
+    FILE *capture = NULL;
+    if(capture_path != NULL) {
+        capture = fopen(capture_path, "w");
+        if(capture == NULL) {
+            fprintf(stderr, "can't open %s: %s\n", capture_path, strerror(errno));
+            exit(1);
+        }
+    }
+
+    signal(SIGINT, on_interrupt);
+    fprintf(stderr, "recording from %s, ^C to stop\n", device);
+
+    uint8_t bytes[MAX_REPORT_BYTES];
+    while(!stop && (limit == 0 || number_of_samples < limit)) {
+
+        ssize_t length = read(fd, bytes, sizeof(bytes));
+        uint64_t host_us = now_us();
+
+        if(length < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "can't read %s: %s\n", device, strerror(errno));
+            break;
+        }
+
+        add_report(host_us, bytes, (size_t)length);
+        if(capture != NULL) {
+            write_report(capture, host_us, bytes, (size_t)length);
+        }
+    }
+
+    if(capture != NULL) {
+        fclose(capture);
+    }
+    close(fd);
+}
+
+static void load(const char *path) {
+
+    FILE *f = fopen(path, "r");
+    if(f == NULL) {
+        fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    char line[1024];
+    while(fgets(line, sizeof(line), f) != NULL) {
+
+        char *p = line;
+        char *end;
+
+        unsigned long long host_us = strtoull(p, &end, 10);
+        if(end == p) {
+            continue;
+        }
+        p = end;
+
+        uint8_t bytes[MAX_REPORT_BYTES];
+        size_t length = 0;
+        while(length < sizeof(bytes)) {
+            unsigned long byte = strtoul(p, &end, 16);
+            if(end == p || byte > 0xff) {
+                break;
+            }
+            bytes[length++] = (uint8_t)byte;
+            p = end;
+        }
+
+        add_report(host_us, bytes, length);
+    }
+
+    fclose(f);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Mean, spread, and percentiles. This sorts the values.
+ */
+static summary summarize(double *values, uint32_t count) {
+
+    summary s;
+    memset(&s, '\0', sizeof(s));
+    s.count = count;
+    if(count == 0) {
+        return s;
+    }
+
+    double sum = 0.0;
+    for(uint32_t i = 0; i < count; i++) {
+        sum += values[i];
+    }
+    s.mean = sum / count;
+
+    double squares = 0.0;
+    for(uint32_t i = 0; i < count; i++) {
+        squares += (values[i] - s.mean) * (values[i] - s.mean);
+    }
+    s.stdev = sqrt(squares / count);
+
+    qsort(values, count, sizeof(double), compare_doubles);
+    s.min = values[0];
+    s.p50 = values[(count - 1) / 2];
+    s.p99 = values[(uint32_t)((count - 1) * 0.99)];
+    s.max = values[count - 1];
+
+    return s;
+}
+
+static void print_summary(const char *name, summary s) {
+
+    if(s.count == 0) {
+        printf("%-10s %10s\n", name, "-");
+        return;
+    }
+
+    printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+           name, s.mean, s.stdev, s.min, s.p50, s.p99, s.max);
+}
+
+static void analyze() {
+
+    if(number_of_samples < 2) {
+        fprintf(stderr, "need at least two joystick reports, only have %u\n", number_of_samples);
+        exit(1);
+    }
+
+    double *host_intervals = malloc(number_of_samples * sizeof(double));
+    double *frame_intervals = malloc(number_of_samples * sizeof(double));
+    double *device_us = malloc(number_of_samples * sizeof(double));
+    double *ages = malloc(number_of_samples * sizeof(double));
+    if(host_intervals == NULL || frame_intervals == NULL || device_us == NULL || ages == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    uint32_t dropped = 0;
+    uint32_t repeated = 0;
+    uint32_t host_count = 0;
+    uint32_t frame_count = 0;
+
+    // The timestamps are 32 bits, so they get unwrapped as they go
+    double device_time = 0.0;
+    device_us[0] = 0.0;
+
+    for(uint32_t i = 1; i < number_of_samples; i++) {
+
+        sample *previous = &samples[i - 1];
+        sample *s = &samples[i];
+
+        uint8_t step = (uint8_t)(s->sequence - previous->sequence);
+        if(step == 0) {
+            repeated++;
+        }
+        else {
+            dropped += step - 1;
+        }
+
+        host_intervals[host_count++] = (double)(s->host_us - previous->host_us);
+
+        uint32_t frame_step = s->timestamp_us - previous->timestamp_us;
+        if(frame_step != 0) {
+            frame_intervals[frame_count++] = (double)frame_step;
+        }
+
+        device_time += frame_step;
+        device_us[i] = device_time;
+    }
+
+    // How far behind the controller's clock the host's is for each report is the latency plus
+    // a fixed offset plus the drift. A straight line through it takes out the drift...
+    double mean_device = 0.0;
+    double mean_offset = 0.0;
+    for(uint32_t i = 0; i < number_of_samples; i++) {
+        mean_device += device_us[i];
+        mean_offset += (double)(samples[i].host_us - samples[0].host_us) - device_us[i];
+    }
+    mean_device /= number_of_samples;
+    mean_offset /= number_of_samples;
+
+    double covariance = 0.0;
+    double variance = 0.0;
+    for(uint32_t i = 0; i < number_of_samples; i++) {
+        double offset = (double)(samples[i].host_us - samples[0].host_us) - device_us[i];
+        covariance += (device_us[i] - mean_device) * (offset - mean_offset);
+        variance += (device_us[i] - mean_device) * (device_us[i] - mean_device);
+    }
+    double drift = variance > 0.0 ? covariance / variance : 0.0;
+
+    // ...and then the quickest report is as close to zero latency as we can know
+    double quickest = INFINITY;
+    for(uint32_t i = 0; i < number_of_samples; i++) {
+        double offset = (double)(samples[i].host_us - samples[0].host_us) - device_us[i];
+        ages[i] = offset - (mean_offset + drift * (device_us[i] - mean_device));
+        quickest = ages[i] < quickest ? ages[i] : quickest;
+    }
+    for(uint32_t i = 0; i < number_of_samples; i++) {
+        ages[i] -= quickest;
+    }
+
+    uint32_t sleeping = 0;
+    uint32_t clipped = 0;
+    uint32_t stale = 0;
+    for(uint32_t i = 0; i < number_of_samples; i++) {
+        sleeping += (samples[i].flags & HID_REPORT_FLAG_FILTER_SLEEPING) ? 1 : 0;
+        clipped += (samples[i].flags & HID_REPORT_FLAG_CLIPPED) ? 1 : 0;
+        stale += (samples[i].flags & HID_REPORT_FLAG_STALE) ? 1 : 0;
+    }
+
+    uint32_t sent = number_of_samples - repeated + dropped;
+
+    printf("reports: %u joystick, %u other\n", number_of_samples, other_reports);
+    printf("dropped: %u of %u (%.3f%%), repeated: %u\n",
+           dropped, sent, 100.0 * dropped / sent, repeated);
+    printf("clock drift: %.1f ppm\n\n", drift * 1e6);
+
+    printf("%-10s %10s %10s %10s %10s %10s %10s\n", "(us)", "mean", "stdev", "min", "p50", "p99", "max");
+    print_summary("host", summarize(host_intervals, host_count));
+    print_summary("frames", summarize(frame_intervals, frame_count));
+    print_summary("age", summarize(ages, number_of_samples));
+
+    printf("\nflags: sleeping %u (%.1f%%), clipped %u (%.1f%%), stale %u (%.1f%%)\n",
+           sleeping, 100.0 * sleeping / number_of_samples,
+           clipped, 100.0 * clipped / number_of_samples,
+           stale, 100.0 * stale / number_of_samples);
+
+    free(host_intervals);
+    free(frame_intervals);
+    free(device_us);
+    free(ages);
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s -r /dev/hidrawN [-n reports] [-w capture.txt]\n", program);
+    fprintf(stderr, "       %s capture.txt\n", program);
+}
+
+int main(int argc, char **argv) {
+
+    const char *device = NULL;
+    const char *capture_path = NULL;
+    uint32_t limit = 0;
+
+    int option;
+    while((option = getopt(argc, argv, "r:n:w:h")) != -1) {
+        switch(option) {
+            case 'r':
+                device = optarg;
+                break;
+            case 'n':
+                limit = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                capture_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return option == 'h' ? 0 : 1;
+        }
+    }
+
+    if(device != NULL) {
+        record(device, limit, capture_path);
+    }
+    else if(optind < argc) {
+        load(argv[optind]);
+    }
+    else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    analyze();
+
+    free(samples);
+    return 0;
+}
+
+#else
+
+int main(int argc, char **argv) {
+
+    (void) argc;
+    (void) argv;
+
+    fprintf(stderr, "This was built with HID_EXTENDED_REPORT off, so there's no sequence numbers or\n");
+    fprintf(stderr, "timestamps to look at. Turn it on in the firmware and here (-DHID_EXTENDED_REPORT=ON).\n");
+    return 1;
+}
+
+#endif
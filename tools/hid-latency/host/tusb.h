@@ -0,0 +1,11 @@
+
+#pragma once
+
+/*
+ * Just enough of TinyUSB for hid_report.h to build on a desktop
+ */
+
+#define TU_ATTR_PACKED                  __attribute__((packed))
+
+// Same as tusb_config.h
+#define CFG_TUD_HID_EP_BUFSIZE          64